@@ -47,6 +47,10 @@
 // https://github.com/todbot/SoftI2CMaster (AVR, but not ATTINY)
 #define FEATURE_TODBOT_WIRE 10
 
+// AvrTwiInterface using the TWI peripheral directly, without <Wire.h> (AVR with
+// TWI only)
+#define FEATURE_AVR_TWI 11
+
 // A volatile integer to prevent the compiler from optimizing away the entire
 // program.
 volatile int disableCompilerOptimization = 0;
@@ -141,6 +145,16 @@ volatile int disableCompilerOptimization = 0;
       #error Unsupported FEATURE on this platform
     #endif
 
+  #elif FEATURE == FEATURE_AVR_TWI
+    #if ! defined(ARDUINO_ARCH_AVR) || ! defined(TWCR)
+      #error Unsupported FEATURE on this platform
+    #endif
+
+    using Master = AvrTwiMaster<AvrTwiRegisters>;
+    Master twiMaster;
+    ACE_WIRE_AVR_TWI_ISR(twiMaster)
+    using WireInterface = AvrTwiInterface<Master>;
+    WireInterface wireInterface(twiMaster, F_CPU);
 
   #else
     #error Unknown FEATURE
@@ -217,6 +231,9 @@ disableCompilerOptimization = 3;
   Wire.begin();
   wireInterface.begin();
 
+#elif FEATURE == FEATURE_AVR_TWI
+  wireInterface.begin();
+
 #else
   #error Unknown FEATURE
 
@@ -240,7 +257,8 @@ void loop() {
     || FEATURE == FEATURE_MARPLE_WIRE \
     || FEATURE == FEATURE_TESTATO_WIRE \
     || FEATURE == FEATURE_THEXENO_WIRE \
-    || FEATURE == FEATURE_TODBOT_WIRE
+    || FEATURE == FEATURE_TODBOT_WIRE \
+    || FEATURE == FEATURE_AVR_TWI
   wireInterface.beginTransmission(DS3231_I2C_ADDRESS);
   wireInterface.write(0x00);
   wireInterface.endTransmission();
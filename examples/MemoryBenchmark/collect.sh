@@ -1,7 +1,7 @@
 #!/bin/bash
 #
 # Shell script that runs 'auniter verify ${board} MemoryBenchmark.ino', and
-# collects the flash memory and static RAM usage for each of the FEATURE [0,5].
+# collects the flash memory and static RAM usage for each of the FEATURE [0,11].
 #
 # Usage: collect.sh {board} {result_file}
 #
@@ -16,7 +16,7 @@
 set -eu
 
 PROGRAM_NAME='MemoryBenchmark.ino'
-NUM_FEATURES=10  # excluding FEATURE_BASELINE
+NUM_FEATURES=11  # excluding FEATURE_BASELINE
 
 # Assume that https://github.com/bxparks/AUniter is installed as a
 # sibling project to AceWire.
@@ -100,6 +100,8 @@ I2C implementations:
     * `SimpleWireInterface`: AceWire's own Software I2C using `digitalWrite()`.
     * `SimpleWireFastInterface`: AceWire's own Software I2C using a
     `digitalWriteFast()` library. (AVR only)
+    * `AvrTwiInterface`: AceWire's own driver of the hardware TWI peripheral,
+      without the buffers of `<Wire.h>`. (AVR only)
 * Native `<Wire.h>` (all platforms)
     * `TwoWireInterface<TwoWire>`: Hardware I2C using preinstalled `<Wire.h>`.
 * Third party libraries (all platforms)
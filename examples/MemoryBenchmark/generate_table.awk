@@ -17,6 +17,7 @@ BEGIN {
   labels[8] = "TestatoWireInterface<SoftwareWire>";
   labels[9] = "ThexenoWireInterface<TwoWire>";
   labels[10] = "TodbotWireInterface<SoftI2CMaster>";
+  labels[11] = "AvrTwiInterface";
   record_index = 0
 }
 {
@@ -50,7 +51,8 @@ END {
         || name ~ /^SimpleWireInterface/ \
         || name ~ /^TwoWireInterface/ \
         || name ~ /^FeliasFoggWireInterface/ \
-        || name ~ /^TestatoWireInterface/) {
+        || name ~ /^TestatoWireInterface/ \
+        || name ~ /^AvrTwiInterface/) {
       printf(\
         "|---------------------------------------+--------------+-------------|\n")
     }
@@ -0,0 +1,115 @@
+/*
+MIT License
+
+Copyright (c) 2022 Brian T. Park
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+/*
+ * A sketch that finds the smallest reliable DELAY_MICROS of
+ * SimpleWireInterface for a DS3231 on the bus, using SpeedCalibrator. The
+ * alarm registers of the DS3231 are used as the test window, and are restored
+ * at the end. Requires an actual DS3231 device on the I2C bus.
+ *
+ * Prints the error statistics of each step, followed by the recommended
+ * DELAY_MICROS.
+ */
+
+#include <Arduino.h>
+#include <AceWire.h>
+using ace_wire::SimpleWireInterface;
+using ace_wire::SpeedCalibrator;
+using ace_wire::SpeedCalibrationStats;
+
+#if ! defined(SERIAL_PORT_MONITOR)
+#define SERIAL_PORT_MONITOR Serial
+#endif
+
+//------------------------------------------------------------------
+// I2C communication configs.
+//------------------------------------------------------------------
+
+const uint8_t SDA_PIN = SDA;
+const uint8_t SCL_PIN = SCL;
+const uint8_t DS3231_I2C_ADDRESS = 0x68;
+
+// Alarm1 and alarm2 registers, which avoid changing the date and time.
+const uint8_t DS3231_ALARM_REGISTER = 0x07;
+const uint8_t DS3231_ALARM_LENGTH = 7;
+
+// Candidate delays, from the slowest to the fastest.
+const uint8_t DELAYS[] = {20, 10, 5, 4, 3, 2, 1, 0};
+const uint8_t NUM_STEPS = sizeof(DELAYS) / sizeof(DELAYS[0]);
+
+const uint16_t NUM_TRIALS = 100;
+const uint8_t SAFETY_MARGIN = 1;
+
+//------------------------------------------------------------------
+
+SimpleWireInterface makeInterface(uint8_t step) {
+  return SimpleWireInterface(SDA_PIN, SCL_PIN, DELAYS[step]);
+}
+
+void runCalibration() {
+  SpeedCalibrator<SimpleWireInterface> calibrator(
+      makeInterface, NUM_STEPS, DS3231_I2C_ADDRESS,
+      DS3231_ALARM_REGISTER, DS3231_ALARM_LENGTH);
+  SpeedCalibrationStats stats[NUM_STEPS];
+  uint8_t step = calibrator.calibrate(NUM_TRIALS, SAFETY_MARGIN, stats);
+
+  SERIAL_PORT_MONITOR.println(F("delayMicros trials busErrors dataErrors"));
+  for (uint8_t i = 0; i < NUM_STEPS; ++i) {
+    SERIAL_PORT_MONITOR.print(DELAYS[i]);
+    SERIAL_PORT_MONITOR.print(' ');
+    SERIAL_PORT_MONITOR.print(stats[i].trials);
+    SERIAL_PORT_MONITOR.print(' ');
+    SERIAL_PORT_MONITOR.print(stats[i].busErrors);
+    SERIAL_PORT_MONITOR.print(' ');
+    SERIAL_PORT_MONITOR.println(stats[i].dataErrors);
+  }
+
+  if (step == SpeedCalibrator<SimpleWireInterface>::kNoStep) {
+    SERIAL_PORT_MONITOR.println(
+        F("Error: no reliable speed found, or registers not restored"));
+  } else {
+    SERIAL_PORT_MONITOR.print(F("Recommended DELAY_MICROS: "));
+    SERIAL_PORT_MONITOR.println(DELAYS[step]);
+  }
+}
+
+//-----------------------------------------------------------------------------
+
+void setup() {
+#if ! defined(EPOXY_DUINO)
+  delay(1000); // Wait for stability on some boards, otherwise garage on Serial
+#endif
+
+  SERIAL_PORT_MONITOR.begin(115200);
+  while (!SERIAL_PORT_MONITOR); // Wait for Leonardo/Micro
+
+  runCalibration();
+  SERIAL_PORT_MONITOR.println(F("Done"));
+
+#if defined(EPOXY_DUINO)
+  exit(0);
+#endif
+}
+
+void loop() {}
@@ -56,6 +56,9 @@ SOFTWARE.
 // file manually, right after the `#include <AceWire.h>`.
 //#include "ace_wire/SimpleWireFastInterface.h"
 
+// Software I2C target (slave), which also requires <digitalWriteFast.h>.
+//#include "ace_wire/SimpleWireTarget.h"
+
 // Wrapper around pre-installed <Wire.h>.
 #include "ace_wire/TwoWireInterface.h"
 
@@ -69,5 +72,37 @@ SOFTWARE.
 #include "ace_wire/TestatoWireInterface.h"
 #include "ace_wire/ThexenoWireInterface.h"
 #include "ace_wire/TodbotWireInterface.h"
+#include "ace_wire/AvrTwiInterface.h"
+
+// Implementation for Linux only, using the i2c-dev interface of the kernel.
+// It pulls in the <linux/i2c-dev.h> headers, so the end-user should include
+// this header file manually, right after the `#include <AceWire.h>`.
+//#include "ace_wire/LinuxI2cDevInterface.h"
+
+// Front-end which queues transactions to a worker on another core.
+#include "ace_wire/QueuedWireInterface.h"
+
+// Recording of the calls on any interface, and their replay without hardware.
+#include "ace_wire/WireLog.h"
+#include "ace_wire/RecordingWireInterface.h"
+#include "ace_wire/ReplayWireInterface.h"
+
+// Adjustment of the speed of each device from the errors of its transactions.
+#include "ace_wire/RateController.h"
+#include "ace_wire/AdaptiveWireInterface.h"
+
+// Helper classes which work with any of the above implementations.
+#include "ace_wire/WireTraits.h"
+#include "ace_wire/Message.h"
+#include "ace_wire/GenericTransfer.h"
+#include "ace_wire/ReadSink.h"
+#include "ace_wire/MemoryDevice.h"
+#include "ace_wire/BulkTransfer.h"
+#include "ace_wire/Ssd1306Streamer.h"
+#include "ace_wire/Smbus.h"
+#include "ace_wire/SpeedCalibrator.h"
+#include "ace_wire/BusArbiter.h"
+#include "ace_wire/Retrier.h"
+#include "ace_wire/PollScheduler.h"
 
 #endif
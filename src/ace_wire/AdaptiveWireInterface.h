@@ -0,0 +1,201 @@
+/*
+MIT License
+
+Copyright (c) 2022 Brian T. Park
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+
+#ifndef ACE_WIRE_ADAPTIVE_WIRE_INTERFACE_H
+#define ACE_WIRE_ADAPTIVE_WIRE_INTERFACE_H
+
+#include <stdint.h>
+#include "WireTraits.h"
+#include "Message.h"
+
+namespace ace_wire {
+
+/**
+ * A wrapper around any AceWire interface (`T_WIREI`) which forwards every call
+ * to it, and reports the outcome of each transaction to a RateController
+ * (`T_CONTROLLER`), which adjusts the speed of the device. The profile table
+ * of the controller must be the one used by the wrapped interface.
+ *
+ * A write transaction, from beginTransmission() to endTransmission(), fails
+ * if a data byte is not acknowledged, or if endTransmission() returns an
+ * error other than an address NACK. The address NACKs, from
+ * beginTransmission() or as status 2 of endTransmission(), are given to
+ * RateController::reportAddressNack() instead, which ignores them by default.
+ * A requestFrom() or readInto() which returns 0 is treated as an address
+ * NACK, because most interfaces cannot fail a read in any other way. The
+ * transfer() and readInto() methods call the native versions of `T_WIREI`,
+ * and report each call as a single outcome. The capabilities of `T_WIREI` are
+ * passed through unchanged.
+ *
+ * @tparam T_WIREI the AceWire interface class, e.g. SimpleWireInterface
+ * @tparam T_CONTROLLER the RateController class
+ */
+template <typename T_WIREI, typename T_CONTROLLER>
+class AdaptiveWireInterface {
+  public:
+    /** Same as `T_WIREI`. */
+    static const bool kSupportsRepeatedStart =
+        WireTraits<T_WIREI>::kSupportsRepeatedStart;
+
+    /** Same as `T_WIREI`. */
+    static const bool kBuffered = WireTraits<T_WIREI>::kBuffered;
+
+    /** Same as `T_WIREI`. */
+    static const uint16_t kBufferSize = WireTraits<T_WIREI>::kBufferSize;
+
+    /** Same as `T_WIREI`. */
+    static const uint16_t kMaxQuantity = WireTraits<T_WIREI>::kMaxQuantity;
+
+    /** Same as `T_WIREI`. */
+    static const bool kReportsAddressNack =
+        WireTraits<T_WIREI>::kReportsAddressNack;
+
+    /**
+     * Constructor.
+     *
+     * @param wireInterface instance of the AceWire interface
+     * @param controller the RateController which receives the outcomes, shared
+     *    by all copies of this interface object
+     */
+    explicit AdaptiveWireInterface(
+        const T_WIREI& wireInterface, T_CONTROLLER& controller) :
+        mWireInterface(wireInterface),
+        mController(controller)
+    {}
+
+    /** Call begin() of the wrapped interface. */
+    void begin() const { mWireInterface.begin(); }
+
+    /** Call end() of the wrapped interface. */
+    void end() const { mWireInterface.end(); }
+
+    /** Forward beginTransmission(), and start tracking the transaction. */
+    uint8_t beginTransmission(uint8_t addr) const {
+      uint8_t result = mWireInterface.beginTransmission(addr);
+      mAddr = addr;
+      mPending = true;
+      mAddressNack = (result != 0);
+      mFailed = false;
+      return result;
+    }
+
+    /** Forward write(). */
+    uint8_t write(uint8_t data) const {
+      uint8_t result = mWireInterface.write(data);
+      if (! result) mFailed = true;
+      return result;
+    }
+
+    /** Forward endTransmission(), and report the outcome. */
+    uint8_t endTransmission(bool sendStop = true) const {
+      uint8_t status = mWireInterface.endTransmission(sendStop);
+      if (mPending) {
+        // After an address NACK, the writes of some interfaces fail too.
+        if (mAddressNack || status == kStatusAddressNack) {
+          mController.reportAddressNack(mAddr);
+        } else {
+          mController.report(mAddr, ! mFailed && status == 0);
+        }
+        mPending = false;
+      }
+      return status;
+    }
+
+    /** Forward requestFrom(), and report the outcome. */
+    uint16_t requestFrom(
+        uint8_t addr, uint16_t quantity, bool sendStop = true) const {
+      uint16_t received = mWireInterface.requestFrom(addr, quantity, sendStop);
+      reportRead(addr, received != 0);
+      return received;
+    }
+
+    /** Forward read(). */
+    uint8_t read() const { return mWireInterface.read(); }
+
+    /**
+     * Forward transfer() to the native implementation of `T_WIREI`, and
+     * report the outcome of the whole call once, for the address of the
+     * failed message, or of the last message if all succeeded. A status of 1
+     * (a message too long, or an empty read) is not reported, because nothing
+     * was sent to the device, and a status of 2 is reported as an address
+     * NACK.
+     */
+    TransferResult transfer(const Message* msgs, uint8_t count) const {
+      TransferResult result = mWireInterface.transfer(msgs, count);
+      if (count != 0 && result.status != 1) {
+        uint8_t i = (result.index < count) ? result.index : count - 1;
+        if (result.status == kStatusAddressNack) {
+          mController.reportAddressNack(msgs[i].addr);
+        } else {
+          mController.report(msgs[i].addr, result.status == 0);
+        }
+      }
+      return result;
+    }
+
+    /**
+     * Forward readInto() to the native implementation of `T_WIREI`, and
+     * report the outcome of the whole call. If the device did not respond,
+     * an address NACK is reported.
+     */
+    template <typename F>
+    uint32_t readInto(
+        uint8_t addr, uint16_t quantity, F&& sink, bool sendStop = true)
+        const {
+      uint32_t n = mWireInterface.readInto(addr, quantity, sink, sendStop);
+      reportRead(addr, n != 0);
+      return n;
+    }
+
+    // Use default copy constructor. Delete the assignment operator because it
+    // cannot work with the reference to the controller.
+    AdaptiveWireInterface(const AdaptiveWireInterface&) = default;
+    AdaptiveWireInterface& operator=(const AdaptiveWireInterface&) = delete;
+
+  private:
+    /** Status code of endTransmission() and transfer() for an address NACK. */
+    static const uint8_t kStatusAddressNack = 2;
+
+    /** Report the outcome of a read, which fails only by an address NACK. */
+    void reportRead(uint8_t addr, bool ok) const {
+      if (ok) {
+        mController.report(addr, true);
+      } else {
+        mController.reportAddressNack(addr);
+      }
+    }
+
+  private:
+    T_WIREI mWireInterface; // copied by value
+    T_CONTROLLER& mController;
+    mutable uint8_t mAddr = 0;
+    mutable bool mPending = false;
+    mutable bool mAddressNack = false;
+    mutable bool mFailed = false;
+};
+
+}
+
+#endif
@@ -0,0 +1,586 @@
+/*
+MIT License
+
+Copyright (c) 2022 Brian T. Park
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef ACE_WIRE_AVR_TWI_INTERFACE_H
+#define ACE_WIRE_AVR_TWI_INTERFACE_H
+
+#include <stdint.h>
+#include <Arduino.h> // millis()
+#include "Message.h"
+#include "ReadSink.h"
+
+#if defined(ARDUINO_ARCH_AVR) && defined(TWCR)
+  #include <avr/io.h>
+  #include <avr/interrupt.h>
+#endif
+
+namespace ace_wire {
+
+#if defined(ARDUINO_ARCH_AVR) && defined(TWCR)
+
+/**
+ * The register map of the TWI peripheral of the ATmega processors, used as the
+ * `T_REGS` parameter of AvrTwiMaster. A test can substitute a class with the
+ * same static methods which simulates the peripheral.
+ */
+struct AvrTwiRegisters {
+  static uint8_t readTwcr() { return TWCR; }
+  static void writeTwcr(uint8_t value) { TWCR = value; }
+  static uint8_t readTwsr() { return TWSR; }
+  static void writeTwsr(uint8_t value) { TWSR = value; }
+  static uint8_t readTwdr() { return TWDR; }
+  static void writeTwdr(uint8_t value) { TWDR = value; }
+  static void writeTwbr(uint8_t value) { TWBR = value; }
+};
+
+/**
+ * Define the TWI interrupt handler, which forwards to the handleInterrupt()
+ * method of the given AvrTwiMaster object. Use this in exactly one .cpp or
+ * .ino file. This cannot be combined with <Wire.h>, which defines the same
+ * interrupt handler.
+ */
+#define ACE_WIRE_AVR_TWI_ISR(master) \
+  ISR(TWI_vect) { (master).handleInterrupt(); }
+
+#endif
+
+/**
+ * A driver of the hardware TWI (I2C) peripheral of the AVR processors, which
+ * uses no internal TX or RX buffer. It supports 2 modes of operation:
+ *
+ *  * Polled byte-by-byte mode, used by the AceWire API of AvrTwiInterface.
+ *    Each byte is transferred directly from the caller to the TWDR register,
+ *    so the interface is unbuffered, like SimpleWireInterface.
+ *  * Interrupt-driven mode, started by startTransfer(), which executes an
+ *    array of Message segments directly out of and into the buffers of the
+ *    caller. The state machine runs in handleInterrupt(), which must be
+ *    called from the TWI interrupt (see ACE_WIRE_AVR_TWI_ISR). The caller
+ *    either polls isBusy() and continues with other work (non-blocking), or
+ *    uses the blocking AvrTwiInterface::transfer().
+ *
+ * All register access goes through the static methods of `T_REGS`, so the
+ * state machine can be tested on a host (e.g. under EpoxyDuino) using a
+ * simulated peripheral.
+ *
+ * @tparam T_REGS the register map, e.g. AvrTwiRegisters
+ */
+template <typename T_REGS>
+class AvrTwiMaster {
+  public:
+    /** TWCR bit: interrupt flag, written as 1 to start the next action. */
+    static const uint8_t kTwint = 0x80;
+
+    /** TWCR bit: send ACK after a received byte. */
+    static const uint8_t kTwea = 0x40;
+
+    /** TWCR bit: send a START condition. */
+    static const uint8_t kTwsta = 0x20;
+
+    /** TWCR bit: send a STOP condition. */
+    static const uint8_t kTwsto = 0x10;
+
+    /** TWCR bit: enable the TWI peripheral. */
+    static const uint8_t kTwen = 0x04;
+
+    /** TWCR bit: enable the TWI interrupt. */
+    static const uint8_t kTwie = 0x01;
+
+    /** Maximum number of polls of TWINT before giving up in polled mode. */
+    static const uint16_t kMaxPolls = 0xFFFF;
+
+    /**
+     * Enable the peripheral with the given clock speed, using a prescaler of
+     * 1. The internal pullup resistors are not enabled.
+     *
+     * @param cpuFrequency clock of the processor in Hz, normally F_CPU
+     * @param clockSpeed speed of SCL in Hz (default 100000)
+     */
+    void begin(uint32_t cpuFrequency, uint32_t clockSpeed = 100000) {
+      T_REGS::writeTwsr(0);
+      T_REGS::writeTwbr((uint8_t) ((cpuFrequency / clockSpeed - 16) / 2));
+      T_REGS::writeTwcr(kTwen);
+    }
+
+    /** Disable the peripheral. */
+    void end() {
+      T_REGS::writeTwcr(0);
+    }
+
+    //-----------------------------------------------------------------------
+    // Interrupt-driven mode.
+    //-----------------------------------------------------------------------
+
+    /**
+     * Start the transfer of `count` segments in the background. The `msgs`
+     * array and the buffers of the segments must remain valid until isBusy()
+     * returns false.
+     *
+     * @return false if a transfer is already in progress
+     */
+    bool startTransfer(const Message* msgs, uint8_t count) {
+      if (mBusy) return false;
+      mMsgs = msgs;
+      mCount = count;
+      mMsgIndex = 0;
+      mStatus = 0;
+      if (count == 0) return true;
+
+      waitForStop();
+      mBusy = true;
+      T_REGS::writeTwcr(kTwint | kTwsta | kTwen | kTwie);
+      return true;
+    }
+
+    /** Return true while a transfer started by startTransfer() is running. */
+    bool isBusy() const { return mBusy; }
+
+    /**
+     * Return the result of the last transfer started by startTransfer(). Only
+     * valid when isBusy() is false.
+     */
+    TransferResult result() const {
+      return TransferResult{mStatus, mMsgIndex};
+    }
+
+    /**
+     * Abort the transfer started by startTransfer(), e.g. when the bus is
+     * stuck. The TWI interrupt is disabled and a STOP condition is sent. If
+     * the transfer was still running, result() returns status 5 (timeout)
+     * and the index of the unfinished segment.
+     */
+    void abortTransfer() {
+      T_REGS::writeTwcr(kTwint | kTwen | kTwsto);
+      if (mBusy) done(5);
+    }
+
+    /** Advance the state machine. Call this from the TWI interrupt. */
+    void handleInterrupt() {
+      const Message& msg = mMsgs[mMsgIndex];
+      switch (T_REGS::readTwsr() & kStatusMask) {
+        case kStart:
+        case kRepeatedStart:
+          mByteIndex = 0;
+          T_REGS::writeTwdr((msg.addr << 1)
+              | ((msg.flags & Message::kRead) ? 1 : 0));
+          T_REGS::writeTwcr(kReply);
+          break;
+
+        case kAddrWriteAck:
+        case kDataWriteAck:
+          if (mByteIndex < msg.len) {
+            T_REGS::writeTwdr(msg.buf[mByteIndex++]);
+            T_REGS::writeTwcr(kReply);
+          } else {
+            nextMessage();
+          }
+          break;
+
+        case kAddrReadAck:
+          replyRead(msg);
+          break;
+
+        case kDataReadAck:
+          msg.buf[mByteIndex++] = T_REGS::readTwdr();
+          replyRead(msg);
+          break;
+
+        case kDataReadNack:
+          // A read of 0 bytes still has to receive one byte, which is dropped.
+          if (mByteIndex < msg.len) msg.buf[mByteIndex++] = T_REGS::readTwdr();
+          nextMessage();
+          break;
+
+        case kAddrWriteNack:
+        case kAddrReadNack:
+          finish(2);
+          break;
+
+        case kDataWriteNack:
+          finish(3);
+          break;
+
+        case kArbitrationLost:
+          // Release the bus without sending a STOP.
+          T_REGS::writeTwcr(kTwint | kTwen);
+          done(4);
+          break;
+
+        default:
+          finish(4);
+          break;
+      }
+    }
+
+    //-----------------------------------------------------------------------
+    // Polled mode, used by AvrTwiInterface.
+    //-----------------------------------------------------------------------
+
+    /**
+     * Send a START (or repeated START) condition followed by the address
+     * byte `addrRw`.
+     *
+     * @return 0 upon ACK, 2 upon NACK, 4 upon any other error
+     */
+    uint8_t pollStart(uint8_t addrRw) {
+      waitForStop();
+      T_REGS::writeTwcr(kTwint | kTwsta | kTwen);
+      uint8_t status = poll();
+      if (status != kStart && status != kRepeatedStart) return 4;
+
+      T_REGS::writeTwdr(addrRw);
+      T_REGS::writeTwcr(kTwint | kTwen);
+      status = poll();
+      if (status == kAddrWriteAck || status == kAddrReadAck) return 0;
+      if (status == kAddrWriteNack || status == kAddrReadNack) return 2;
+      return 4;
+    }
+
+    /** Send a data byte. Returns true upon ACK. */
+    bool pollWrite(uint8_t data) {
+      T_REGS::writeTwdr(data);
+      T_REGS::writeTwcr(kTwint | kTwen);
+      return poll() == kDataWriteAck;
+    }
+
+    /** Receive a data byte, followed by an ACK if `ack` is true. */
+    uint8_t pollRead(bool ack) {
+      T_REGS::writeTwcr(kTwint | kTwen | (ack ? kTwea : 0));
+      poll();
+      return T_REGS::readTwdr();
+    }
+
+    /** Send the STOP condition. */
+    void pollStop() {
+      T_REGS::writeTwcr(kTwint | kTwen | kTwsto);
+    }
+
+    /**
+     * Send the address byte `addrRw` with the read bit, and prepare to
+     * receive `quantity` bytes using pollReadNext().
+     *
+     * @return `quantity` upon ACK, 0 otherwise
+     */
+    uint16_t pollRequestFrom(uint8_t addrRw, uint16_t quantity, bool sendStop) {
+      mQuantity = 0;
+      if (pollStart(addrRw)) {
+        if (sendStop) pollStop();
+        return 0;
+      }
+      mQuantity = quantity;
+      mSendStop = sendStop;
+      return quantity;
+    }
+
+    /**
+     * Receive the next byte requested by pollRequestFrom(), sending a NACK
+     * after the last byte, followed by the STOP condition if requested.
+     * Returns 0xff if called after the last byte.
+     */
+    uint8_t pollReadNext() {
+      if (! mQuantity) return 0xff;
+
+      mQuantity--;
+      uint8_t data = pollRead(mQuantity != 0);
+      if (mQuantity == 0 && mSendStop) pollStop();
+      return data;
+    }
+
+  private:
+    /** Mask of the status bits of TWSR. */
+    static const uint8_t kStatusMask = 0xF8;
+
+    static const uint8_t kStart = 0x08;
+    static const uint8_t kRepeatedStart = 0x10;
+    static const uint8_t kAddrWriteAck = 0x18;
+    static const uint8_t kAddrWriteNack = 0x20;
+    static const uint8_t kDataWriteAck = 0x28;
+    static const uint8_t kDataWriteNack = 0x30;
+    static const uint8_t kArbitrationLost = 0x38;
+    static const uint8_t kAddrReadAck = 0x40;
+    static const uint8_t kAddrReadNack = 0x48;
+    static const uint8_t kDataReadAck = 0x50;
+    static const uint8_t kDataReadNack = 0x58;
+
+    /** TWCR value which continues with the next action in interrupt mode. */
+    static const uint8_t kReply = kTwint | kTwen | kTwie;
+
+    /** Receive the next byte, with an ACK unless it is the last one. */
+    void replyRead(const Message& msg) {
+      bool ack = (uint16_t) (mByteIndex + 1) < msg.len;
+      T_REGS::writeTwcr(kReply | (ack ? kTwea : 0));
+    }
+
+    /**
+     * Continue with the next segment using a repeated START, or finish the
+     * transfer with a STOP after the last one.
+     */
+    void nextMessage() {
+      mMsgIndex++;
+      if (mMsgIndex < mCount) {
+        T_REGS::writeTwcr(kTwint | kTwsta | kTwen | kTwie);
+      } else {
+        finish(0);
+      }
+    }
+
+    /** Send the STOP condition and end the transfer. */
+    void finish(uint8_t status) {
+      T_REGS::writeTwcr(kTwint | kTwen | kTwsto);
+      done(status);
+    }
+
+    /** End the transfer. */
+    void done(uint8_t status) {
+      mStatus = status;
+      mBusy = false;
+    }
+
+    /** Wait until the previous STOP condition has been sent. */
+    void waitForStop() const {
+      for (uint16_t i = 0; i < kMaxPolls; ++i) {
+        if (! (T_REGS::readTwcr() & kTwsto)) break;
+      }
+    }
+
+    /**
+     * Wait for TWINT and return the status bits of TWSR, or 0x00 (bus error)
+     * upon timeout.
+     */
+    uint8_t poll() const {
+      for (uint16_t i = 0; i < kMaxPolls; ++i) {
+        if (T_REGS::readTwcr() & kTwint) {
+          return T_REGS::readTwsr() & kStatusMask;
+        }
+      }
+      return 0x00;
+    }
+
+  private:
+    // Polled mode.
+    uint16_t mQuantity = 0;
+    bool mSendStop = true;
+
+    // Interrupt-driven mode.
+    const Message* mMsgs = nullptr;
+    uint16_t mByteIndex = 0;
+    uint8_t mCount = 0;
+    volatile uint8_t mMsgIndex = 0;
+    volatile uint8_t mStatus = 0;
+    volatile bool mBusy = false;
+};
+
+/**
+ * An implementation of the AceWire interface using the hardware TWI
+ * peripheral of the AVR processors through an AvrTwiMaster, without the TX and
+ * RX buffers of the `TwoWire` class. The AceWire API methods poll the
+ * peripheral, transferring each byte directly to or from the caller, so the
+ * interface is unbuffered and reports the NACK of the address in
+ * beginTransmission(). The transfer() method uses the interrupt-driven mode of
+ * AvrTwiMaster and waits for its completion.
+ *
+ * @tparam T_MASTER the AvrTwiMaster class, e.g.
+ *    `AvrTwiMaster<AvrTwiRegisters>`
+ */
+template <typename T_MASTER>
+class AvrTwiInterface {
+  public:
+    /** The `sendStop = false` parameter is honored. */
+    static const bool kSupportsRepeatedStart = true;
+
+    /** Data is sent to the bus immediately by write(). */
+    static const bool kBuffered = false;
+
+    /** No buffer, so the size of a transaction is not limited. */
+    static const uint16_t kBufferSize = 0;
+
+    /** Maximum quantity of requestFrom(). */
+    static const uint16_t kMaxQuantity = 65535;
+
+    /** The beginTransmission() method reports the NACK of the address. */
+    static const bool kReportsAddressNack = true;
+
+    /**
+     * Constructor.
+     * @param master instance of AvrTwiMaster, shared by all copies of this
+     *    interface object
+     * @param cpuFrequency clock of the processor in Hz, normally F_CPU
+     * @param clockSpeed speed of SCL in Hz (default 100000)
+     * @param transferTimeoutMillis maximum duration of transfer() (default
+     *    100), which must be long enough for the largest array of messages
+     */
+    explicit AvrTwiInterface(
+        T_MASTER& master,
+        uint32_t cpuFrequency,
+        uint32_t clockSpeed = 100000,
+        uint16_t transferTimeoutMillis = 100
+    ) :
+        mMaster(master),
+        mCpuFrequency(cpuFrequency),
+        mClockSpeed(clockSpeed),
+        mTransferTimeoutMillis(transferTimeoutMillis)
+    {}
+
+    /** Enable the TWI peripheral. */
+    void begin() const {
+      mMaster.begin(mCpuFrequency, mClockSpeed);
+    }
+
+    /** Disable the TWI peripheral. */
+    void end() const {
+      mMaster.end();
+    }
+
+    /**
+     * Send the START condition and the I2C address on the bus immediately.
+     *
+     * @return 0 upon ACK from the device, 1 upon NACK or bus error
+     */
+    uint8_t beginTransmission(uint8_t addr) const {
+      return mMaster.pollStart(addr << 1) ? 1 : 0;
+    }
+
+    /**
+     * Send the data byte on the bus immediately.
+     *
+     * @return 1 upon ACK from the device, 0 upon NACK
+     */
+    uint8_t write(uint8_t data) const {
+      return mMaster.pollWrite(data) ? 1 : 0;
+    }
+
+    /**
+     * Send the STOP condition if `sendStop` is true. Otherwise, the bus is
+     * held so that the next START condition is a repeated START.
+     *
+     * @return always 0, since errors are reported by beginTransmission() and
+     *    write()
+     */
+    uint8_t endTransmission(bool sendStop = true) const {
+      if (sendStop) mMaster.pollStop();
+      return 0;
+    }
+
+    /**
+     * Send the START condition and the I2C address with the read bit. The
+     * bytes are received by read().
+     *
+     * @param addr I2C address
+     * @param quantity number of bytes to read
+     * @param sendStop whether the STOP condition should be sent after the
+     *    last byte
+     *
+     * @return `quantity` upon ACK from the device, 0 otherwise
+     */
+    uint16_t requestFrom(
+        uint8_t addr, uint16_t quantity, bool sendStop = true) const {
+      return mMaster.pollRequestFrom((addr << 1) | 0x01, quantity, sendStop);
+    }
+
+    /**
+     * Read the next byte from the bus, sending an ACK, or a NACK after the
+     * last byte followed by the STOP condition if requested. Returns 0xff if
+     * called after the last byte.
+     */
+    uint8_t read() const {
+      return mMaster.pollReadNext();
+    }
+
+    /**
+     * Execute the array of `count` messages using the interrupt-driven mode
+     * of AvrTwiMaster, directly out of and into the buffers of the messages,
+     * and wait for the completion. The TWI interrupt handler must be
+     * installed using ACE_WIRE_AVR_TWI_ISR().
+     *
+     * If the transfer does not complete within `transferTimeoutMillis` (e.g.
+     * a device holds SCL low, or the interrupt handler is missing), it is
+     * aborted with a STOP condition and status 5 is returned.
+     */
+    TransferResult transfer(const Message* msgs, uint8_t count) const {
+      uint8_t empty = findEmptyRead(msgs, count);
+      if (empty < count) return TransferResult{1, empty};
+      if (! mMaster.startTransfer(msgs, count)) {
+        return TransferResult{4, 0};
+      }
+
+      uint16_t startMillis = millis();
+      while (mMaster.isBusy()) {
+        if ((uint16_t) ((uint16_t) millis() - startMillis)
+            >= mTransferTimeoutMillis) {
+          mMaster.abortTransfer();
+          break;
+        }
+      }
+      return mMaster.result();
+    }
+
+    /**
+     * Read up to `quantity` bytes (0 for no limit) from the device at `addr`
+     * in polled mode, passing each byte to the `sink` functor with the
+     * signature `bool(uint8_t data)` as soon as it is received, without any
+     * buffer. The TWI peripheral decides the ACK of a byte before receiving
+     * it, so if the sink returns false, one more byte is received with a NACK
+     * and discarded.
+     *
+     * @return the number of bytes passed to the sink, 0 if the device did not
+     *    respond
+     */
+    template <typename F>
+    uint32_t readInto(
+        uint8_t addr, uint16_t quantity, F&& sink, bool sendStop = true)
+        const {
+      if (mMaster.pollStart((addr << 1) | 0x01)) {
+        if (sendStop) mMaster.pollStop();
+        return 0;
+      }
+
+      uint32_t count = 0;
+      bool more = true;
+      for (;;) {
+        bool last = ! more || (quantity != 0 && count + 1 >= quantity);
+        uint8_t data = mMaster.pollRead(! last);
+        if (more) {
+          count++;
+          more = sink(data);
+        }
+        if (last) break;
+      }
+      if (sendStop) mMaster.pollStop();
+      return count;
+    }
+
+    // Use default copy constructor. Delete the assignment operator because it
+    // cannot work with constant fields.
+    AvrTwiInterface(const AvrTwiInterface&) = default;
+    AvrTwiInterface& operator=(const AvrTwiInterface&) = delete;
+
+  private:
+    T_MASTER& mMaster;
+    uint32_t const mCpuFrequency;
+    uint32_t const mClockSpeed;
+    uint16_t const mTransferTimeoutMillis;
+};
+
+}
+
+#endif
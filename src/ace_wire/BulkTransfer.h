@@ -0,0 +1,196 @@
+/*
+MIT License
+
+Copyright (c) 2022 Brian T. Park
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef ACE_WIRE_BULK_TRANSFER_H
+#define ACE_WIRE_BULK_TRANSFER_H
+
+#include <stdint.h>
+#include "WireTraits.h"
+
+namespace ace_wire {
+
+/**
+ * Transfer blocks of up to 65535 bytes using any of the AceWire interfaces
+ * (`T_WIREI`), automatically splitting the block into pieces which fit into the
+ * TX/RX buffer of buffered interfaces. The pieces are joined using repeated
+ * START conditions, and the STOP condition is sent only after the last piece.
+ *
+ * For unbuffered interfaces (e.g. SimpleWireInterface), use a `maxChunk` of 0,
+ * and the entire block is streamed directly to or from the bus in a single
+ * transaction. The default `maxChunk` is taken from WireTraits, which selects
+ * the appropriate value for each interface at compile time. Reads are further
+ * limited by the maximum `quantity` of requestFrom() of the interface.
+ *
+ * Each write piece is a new I2C write transaction from the point of view of
+ * the device, so most devices expect it to start with the same command or
+ * register byte(s). These are given as the `prefix` of write(), and are resent
+ * at the start of every piece (e.g. the 0x40 control byte of an SSD1306, or
+ * the FIFO register of a sensor). A read piece simply continues where the
+ * previous one left off, which is how the FIFOs and the auto-incrementing
+ * registers of most devices behave.
+ *
+ * Interfaces without repeated START (see WireTraits) end every piece with a
+ * STOP instead. LinuxI2cDevInterface joins the pieces in a single ioctl() as
+ * long as they fit into its buffers, and submits the earlier pieces
+ * separately otherwise.
+ *
+ * The methods return the status codes of endTransmission():
+ *
+ *  * 0: success
+ *  * 1: length too long for buffer
+ *  * 2: address send, NACK received
+ *  * 3: data send, NACK received
+ *  * 4: other twi error (lost bus arbitration, bus error, ..)
+ *
+ * @tparam T_WIREI the AceWire interface class, e.g. TwoWireInterface
+ */
+template <typename T_WIREI>
+class BulkTransfer {
+  public:
+    /**
+     * Constructor.
+     *
+     * @param wireInterface instance of the AceWire interface
+     * @param maxChunk the maximum number of bytes which can be sent or
+     *    received in a single transaction by `T_WIREI`, i.e. the size of its
+     *    TX/RX buffer (e.g. 32 for TwoWireInterface on AVR, 128 on ESP8266 and
+     *    ESP32), or 0 for unbuffered interfaces (default
+     *    WireTraits<T_WIREI>::kBufferSize)
+     */
+    explicit BulkTransfer(
+        const T_WIREI& wireInterface,
+        uint16_t maxChunk = WireTraits<T_WIREI>::kBufferSize
+    ) :
+        mWireInterface(wireInterface),
+        mMaxChunk(maxChunk)
+    {}
+
+    /**
+     * Write `len` bytes from `buf` to the device at `addr`, preceded by the
+     * `prefixLen` bytes of `prefix` in every piece.
+     *
+     * @param addr I2C address of the device
+     * @param prefix bytes sent at the start of every piece, can be nullptr if
+     *    `prefixLen` is 0
+     * @param prefixLen number of bytes in prefix, must be smaller than
+     *    `maxChunk`
+     * @param buf data bytes
+     * @param len number of data bytes
+     * @param sendStop whether to send the STOP condition after the last piece
+     *
+     * @return 0 upon success, otherwise a status code
+     */
+    uint8_t write(
+        uint8_t addr,
+        const uint8_t* prefix, uint8_t prefixLen,
+        const uint8_t* buf, uint16_t len,
+        bool sendStop = true
+    ) const {
+      if (mMaxChunk && prefixLen >= mMaxChunk) return 1;
+      uint16_t maxData = mMaxChunk ? mMaxChunk - prefixLen : len;
+
+      do {
+        uint16_t n = (len < maxData) ? len : maxData;
+        len -= n;
+        uint8_t status = writePiece(
+            addr, prefix, prefixLen, buf, n, len ? false : sendStop);
+        if (status) return status;
+        buf += n;
+      } while (len);
+
+      return 0;
+    }
+
+    /**
+     * Read `len` bytes from the device at `addr` into `buf`.
+     *
+     * @param addr I2C address of the device
+     * @param buf destination buffer
+     * @param len number of bytes to read
+     * @param sendStop whether to send the STOP condition after the last piece
+     *
+     * @return 0 upon success, 2 if the device did not respond
+     */
+    uint8_t read(
+        uint8_t addr, uint8_t* buf, uint16_t len, bool sendStop = true) const {
+      uint16_t limit = WireTraits<T_WIREI>::kMaxQuantity;
+      uint16_t maxRead = (mMaxChunk != 0 && mMaxChunk < limit)
+          ? mMaxChunk : limit;
+
+      while (len) {
+        uint16_t n = (len < maxRead) ? len : maxRead;
+        len -= n;
+        bool stop = len ? false : sendStop;
+        if (mWireInterface.requestFrom(addr, n, stop) == 0) {
+          if (! stop) endRead(mWireInterface, addr);
+          return 2;
+        }
+        for (uint16_t i = 0; i < n; ++i) {
+          *buf++ = mWireInterface.read();
+        }
+      }
+
+      return 0;
+    }
+
+    // Use default copy constructor. Delete the assignment operator because it
+    // cannot work with constant fields.
+    BulkTransfer(const BulkTransfer&) = default;
+    BulkTransfer& operator=(const BulkTransfer&) = delete;
+
+  private:
+    /** Send a single write transaction. */
+    uint8_t writePiece(
+        uint8_t addr,
+        const uint8_t* prefix, uint8_t prefixLen,
+        const uint8_t* buf, uint16_t n,
+        bool sendStop
+    ) const {
+      if (mWireInterface.beginTransmission(addr)) {
+        mWireInterface.endTransmission();
+        return 2;
+      }
+
+      uint8_t status = 0;
+      for (uint8_t i = 0; status == 0 && i < prefixLen; ++i) {
+        if (! mWireInterface.write(prefix[i])) status = 3;
+      }
+      for (uint16_t i = 0; status == 0 && i < n; ++i) {
+        if (! mWireInterface.write(buf[i])) status = 3;
+      }
+
+      // Always terminate the transaction with a STOP upon failure.
+      uint8_t endStatus = mWireInterface.endTransmission(
+          status ? true : sendStop);
+      return status ? status : endStatus;
+    }
+
+  private:
+    T_WIREI mWireInterface; // copied by value
+    uint16_t const mMaxChunk;
+};
+
+}
+
+#endif
@@ -0,0 +1,241 @@
+/*
+MIT License
+
+Copyright (c) 2022 Brian T. Park
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef ACE_WIRE_BUS_ARBITER_H
+#define ACE_WIRE_BUS_ARBITER_H
+
+#include <stdint.h>
+#include <Arduino.h> // micros()
+
+namespace ace_wire {
+
+/** Usage statistics of a single client of the BusArbiter. */
+struct BusClientStats {
+  /** Number of times the bus was acquired. */
+  uint16_t acquisitions;
+
+  /** Total time spent waiting for the bus, in microseconds. */
+  uint32_t waitMicros;
+
+  /** Longest single wait for the bus, in microseconds. */
+  uint32_t maxWaitMicros;
+
+  /** Total time the bus was held, in microseconds. */
+  uint32_t holdMicros;
+
+  /** Longest single hold of the bus, in microseconds. */
+  uint32_t maxHoldMicros;
+};
+
+/**
+ * A cooperative lock which serializes the multi-call transactions
+ * (beginTransmission() ... endTransmission(), requestFrom() ... read()) of
+ * several clients, e.g. AceRoutine coroutines, sharing a single AceWire
+ * interface. The tryAcquire() method never blocks, so a coroutine waits for
+ * the bus by yielding:
+ *
+ * @code
+ * COROUTINE_AWAIT(arbiter.tryAcquire(kSensorClient));
+ * ...transaction...
+ * arbiter.release(kSensorClient);
+ * @endcode
+ *
+ * A client which calls tryAcquire() is registered as waiting until it gets
+ * the bus, so that the next owner can be chosen fairly when the bus is
+ * released:
+ *
+ *  * kFifo: in the order in which the clients started waiting
+ *  * kPriority: the waiting client with the highest priority (see
+ *    setPriority()), then in FIFO order
+ *
+ * A client which stops waiting without acquiring the bus must call cancel(),
+ * otherwise it blocks the clients behind it.
+ *
+ * The order of arrival is kept with 16-bit tickets, which may wrap around.
+ * The FIFO order is correct as long as fewer than 65536 tickets (one for each
+ * call of tryAcquire() by a client which was not waiting) are issued while
+ * the oldest client waits. This can only be exceeded with kPriority, by a
+ * client starved by clients of a higher priority.
+ *
+ * The time spent waiting for and holding the bus is recorded for each client
+ * (see stats()), to find the clients which hog the bus.
+ *
+ * @tparam T_NUM_CLIENTS number of clients, identified by 0 to
+ *    `T_NUM_CLIENTS - 1`
+ */
+template <uint8_t T_NUM_CLIENTS>
+class BusArbiter {
+  public:
+    /** Grant the bus in the order of arrival. */
+    static const uint8_t kFifo = 0;
+
+    /** Grant the bus to the waiting client with the highest priority. */
+    static const uint8_t kPriority = 1;
+
+    /** Value of owner() when the bus is free. */
+    static const uint8_t kNoClient = 0xFF;
+
+    /**
+     * Constructor.
+     * @param policy kFifo or kPriority
+     */
+    explicit BusArbiter(uint8_t policy = kFifo) :
+        mPolicy(policy)
+    {
+      for (uint8_t i = 0; i < T_NUM_CLIENTS; ++i) {
+        mClients[i].priority = 0;
+        mClients[i].waiting = false;
+      }
+      resetStats();
+    }
+
+    /**
+     * Set the priority of `client` for the kPriority policy. Larger values
+     * are served first. Default 0.
+     */
+    void setPriority(uint8_t client, uint8_t priority) {
+      if (client >= T_NUM_CLIENTS) return;
+      mClients[client].priority = priority;
+    }
+
+    /**
+     * Acquire the bus for `client` if it is free and no other client has
+     * precedence. Otherwise, register the client as waiting and return false.
+     * Returns true if the client already owns the bus.
+     */
+    bool tryAcquire(uint8_t client) {
+      if (client >= T_NUM_CLIENTS) return false;
+      if (mOwner == client) return true;
+
+      Client& c = mClients[client];
+      if (! c.waiting) {
+        c.waiting = true;
+        c.ticket = mNextTicket++;
+        c.waitStart = micros();
+      }
+      if (mOwner != kNoClient || nextClient() != client) return false;
+
+      uint32_t now = micros();
+      uint32_t wait = now - c.waitStart;
+      c.waiting = false;
+      mOwner = client;
+      mHoldStart = now;
+
+      BusClientStats& s = mStats[client];
+      s.acquisitions++;
+      s.waitMicros += wait;
+      if (wait > s.maxWaitMicros) s.maxWaitMicros = wait;
+      return true;
+    }
+
+    /** Release the bus. Does nothing if `client` is not the owner. */
+    void release(uint8_t client) {
+      if (client >= T_NUM_CLIENTS || mOwner != client) return;
+      uint32_t hold = micros() - mHoldStart;
+      mOwner = kNoClient;
+
+      BusClientStats& s = mStats[client];
+      s.holdMicros += hold;
+      if (hold > s.maxHoldMicros) s.maxHoldMicros = hold;
+    }
+
+    /** Stop waiting for the bus, without acquiring it. */
+    void cancel(uint8_t client) {
+      if (client >= T_NUM_CLIENTS) return;
+      mClients[client].waiting = false;
+    }
+
+    /** Return the client which owns the bus, or kNoClient. */
+    uint8_t owner() const { return mOwner; }
+
+    /** Return true if the bus is owned by a client. */
+    bool isBusy() const { return mOwner != kNoClient; }
+
+    /** Return the statistics of `client`. */
+    const BusClientStats& stats(uint8_t client) const {
+      return mStats[client];
+    }
+
+    /** Clear the statistics of all clients. */
+    void resetStats() {
+      for (uint8_t i = 0; i < T_NUM_CLIENTS; ++i) {
+        mStats[i] = BusClientStats{0, 0, 0, 0, 0};
+      }
+    }
+
+    // Delete the copy constructor and assignment operator because this object
+    // is shared by all clients.
+    BusArbiter(const BusArbiter&) = delete;
+    BusArbiter& operator=(const BusArbiter&) = delete;
+
+  private:
+    /** Waiting state of a client. */
+    struct Client {
+      uint32_t waitStart;
+      uint16_t ticket;
+      uint8_t priority;
+      bool waiting;
+    };
+
+    /**
+     * Return the waiting client which should get the bus next, or kNoClient.
+     * The age of a ticket is calculated relative to mNextTicket, so that the
+     * tickets can wrap around (see the class comment for the limit).
+     */
+    uint8_t nextClient() const {
+      uint8_t next = kNoClient;
+      for (uint8_t i = 0; i < T_NUM_CLIENTS; ++i) {
+        const Client& c = mClients[i];
+        if (! c.waiting) continue;
+        if (next == kNoClient) {
+          next = i;
+          continue;
+        }
+        const Client& n = mClients[next];
+        if (mPolicy == kPriority && c.priority != n.priority) {
+          if (c.priority > n.priority) next = i;
+        } else if (age(c) > age(n)) {
+          next = i;
+        }
+      }
+      return next;
+    }
+
+    /** Number of tickets issued since the ticket of `c`. */
+    uint16_t age(const Client& c) const {
+      return mNextTicket - c.ticket;
+    }
+
+  private:
+    uint8_t const mPolicy;
+    uint8_t mOwner = kNoClient;
+    uint16_t mNextTicket = 0;
+    uint32_t mHoldStart = 0;
+    Client mClients[T_NUM_CLIENTS];
+    BusClientStats mStats[T_NUM_CLIENTS];
+};
+
+}
+
+#endif
@@ -26,6 +26,7 @@ SOFTWARE.
 #define ACE_WIRE_FELIAS_FOGG_WIRE_INTERFACE_H
 
 #include <stdint.h>
+#include "GenericTransfer.h"
 
 namespace ace_wire {
 
@@ -38,8 +39,30 @@ namespace ace_wire {
  * @tparam T_WIRE underlying I2C class which will always be `SlowSoftWire`
  */
 template <typename T_WIRE>
-class FeliasFoggWireInterface {
+class FeliasFoggWireInterface :
+    public GenericTransfer<FeliasFoggWireInterface<T_WIRE>> {
   public:
+    /**
+     * The `sendStop = false` parameter of endTransmission() and requestFrom()
+     * is honored, so the next transaction begins with a repeated START.
+     */
+    static const bool kSupportsRepeatedStart = true;
+
+    /** Data is buffered, and sent to the bus by endTransmission(). */
+    static const bool kBuffered = true;
+
+    /** Size of the TX and RX buffers. */
+    static const uint16_t kBufferSize = 32;
+
+    /** Maximum quantity of requestFrom(), limited by the RX buffer. */
+    static const uint16_t kMaxQuantity = 32;
+
+    /**
+     * The beginTransmission() method always returns 0. The NACK of the address
+     * is reported by endTransmission().
+     */
+    static const bool kReportsAddressNack = false;
+
     /**
      * Constructor.
      * @param wire instance of `SlowSoftWire`
@@ -94,15 +117,17 @@ class FeliasFoggWireInterface {
      * Read bytes from the slave and store in buffer owned by SoftWire
      *
      * @param addr I2C address
-     * @param quantity number of bytes to read from I2C bus
+     * @param quantity number of bytes to read from I2C bus, at most 255
      * @param sendStop controls whether the STOP condition should be sent
      *
      * @return the value returned by the underlying SoftWire::requestFrom()
      * method, which will normally be 'quantity'.
      */
-    uint8_t requestFrom(uint8_t addr, uint8_t quantity, bool sendStop = true)
-        const {
-      return mWire.requestFrom(addr, quantity, sendStop);
+    uint16_t requestFrom(
+        uint8_t addr, uint16_t quantity, bool sendStop = true) const {
+      // The underlying library supports only an 8-bit quantity.
+      if (quantity > 255) return 0;
+      return mWire.requestFrom(addr, (uint8_t) quantity, sendStop);
     }
 
     /** Read byte from buffer. */
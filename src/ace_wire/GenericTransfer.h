@@ -0,0 +1,79 @@
+/*
+MIT License
+
+Copyright (c) 2022 Brian T. Park
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+
+#ifndef ACE_WIRE_GENERIC_TRANSFER_H
+#define ACE_WIRE_GENERIC_TRANSFER_H
+
+#include <stdint.h>
+#include "Message.h"
+#include "ReadSink.h"
+
+namespace ace_wire {
+
+/**
+ * A base class which provides the transfer() and readInto() methods of an
+ * interface class `T_WIREI` which has no native support for them, using its
+ * byte-level methods. The interface class derives from this class, passing
+ * itself as `T_WIREI`. The class is empty, so it adds nothing to the size of
+ * the interface object.
+ *
+ * The behavior depends on the capabilities of `T_WIREI` (see WireTraits),
+ * so the documentation of each interface class describes only where it
+ * differs from the usual repeated START between the messages.
+ *
+ * @tparam T_WIREI the AceWire interface class which derives from this class
+ */
+template <typename T_WIREI>
+class GenericTransfer {
+  public:
+    /**
+     * Execute the array of `count` messages as a single combined transaction,
+     * with a STOP condition after the last message. See transferMessages().
+     */
+    TransferResult transfer(const Message* msgs, uint8_t count) const {
+      return transferMessages(self(), msgs, count);
+    }
+
+    /**
+     * Read up to `quantity` bytes (0 for no limit) from the device at `addr`,
+     * passing each byte to the `sink` functor until it returns false. See
+     * streamRead().
+     */
+    template <typename F>
+    uint32_t readInto(
+        uint8_t addr, uint16_t quantity, F&& sink, bool sendStop = true)
+        const {
+      return streamRead(self(), addr, quantity, sink, sendStop);
+    }
+
+  private:
+    const T_WIREI& self() const {
+      return static_cast<const T_WIREI&>(*this);
+    }
+};
+
+}
+
+#endif
@@ -0,0 +1,453 @@
+/*
+MIT License
+
+Copyright (c) 2022 Brian T. Park
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef ACE_WIRE_LINUX_I2C_DEV_INTERFACE_H
+#define ACE_WIRE_LINUX_I2C_DEV_INTERFACE_H
+
+// The i2c-dev interface exists only on Linux, e.g. a Raspberry Pi, or
+// EpoxyDuino running on a Linux machine.
+#if defined(__linux__)
+
+#include <stdint.h>
+#include <string.h> // memmove()
+#include <errno.h>
+#include <fcntl.h> // open()
+#include <unistd.h> // close()
+#include <sys/ioctl.h> // ioctl()
+#include <linux/i2c.h> // struct i2c_msg, I2C_M_RD
+#include <linux/i2c-dev.h> // I2C_RDWR, struct i2c_rdwr_ioctl_data
+#include "Message.h"
+#include "ReadSink.h"
+
+namespace ace_wire {
+
+/**
+ * An I2C adapter of the Linux kernel, accessed through its `/dev/i2c-N`
+ * character device. It holds the file descriptor, and accumulates the segments
+ * of the current transaction (joined by repeated STARTs) in a TX buffer, an RX
+ * buffer and an array of `struct i2c_msg`. The transaction is submitted to the
+ * kernel as a single `I2C_RDWR` ioctl(), so a transaction costs one system call
+ * instead of one per byte.
+ *
+ * If the segments of a transaction do not fit into the buffers together (e.g.
+ * the pieces of a BulkTransfer), the earlier segments are submitted ahead of
+ * time, and the rest of the transaction continues in the buffers. The kernel
+ * ends the early ioctl() with a STOP, so the transaction is then split at that
+ * point. An error of the early ioctl() is returned at the end of the
+ * transaction. Only a single segment longer than kBufferSize overflows.
+ *
+ * This object is shared by all copies of LinuxI2cDevInterface, the same way
+ * that the `Wire` object is shared by all copies of TwoWireInterface.
+ *
+ * The ioctl() is performed by a `RdwrFunction`, which can be replaced in the
+ * constructor to test drivers without an I2C adapter (the `i2c-stub` kernel
+ * module is the other alternative).
+ */
+class LinuxI2cDev {
+  public:
+    /** Size of the TX buffer and of the RX buffer. */
+    static const uint16_t kBufferSize = 256;
+
+    /** Maximum number of segments in a single transaction. */
+    static const uint8_t kMaxMessages = 8;
+
+    /**
+     * Function which submits the combined transaction to the kernel. Returns
+     * 0 upon success, or the `errno` of the failure.
+     */
+    typedef int (*RdwrFunction)(int fd, struct i2c_rdwr_ioctl_data* data);
+
+    /** Submit the transaction using the I2C_RDWR ioctl(). */
+    static int ioctlRdwr(int fd, struct i2c_rdwr_ioctl_data* data) {
+      return (ioctl(fd, I2C_RDWR, data) < 0) ? errno : 0;
+    }
+
+    /**
+     * Convert the `errno` of a failed I2C_RDWR into a status code of
+     * endTransmission(). The kernel does not distinguish between the NACK of
+     * the address and the NACK of a data byte. Most adapter drivers return
+     * ENXIO or EREMOTEIO for either, which are mapped to 2.
+     */
+    static uint8_t errnoToStatus(int err) {
+      switch (err) {
+        case 0: return 0;
+        case ENXIO: return 2;
+        case EREMOTEIO: return 2;
+        default: return 4;
+      }
+    }
+
+    /**
+     * Constructor.
+     * @param rdwr function which submits the transaction (default
+     *    ioctlRdwr())
+     */
+    explicit LinuxI2cDev(RdwrFunction rdwr = ioctlRdwr) :
+        mRdwr(rdwr)
+    {}
+
+    /** Close the device file if it is still open. */
+    ~LinuxI2cDev() { close(); }
+
+    /**
+     * Open the adapter device file, e.g. "/dev/i2c-1". Returns true upon
+     * success.
+     */
+    bool open(const char* path) {
+      close();
+      mFd = ::open(path, O_RDWR);
+      return mFd >= 0;
+    }
+
+    /**
+     * Use a file descriptor which was opened by the caller. It is closed by
+     * close().
+     */
+    void attach(int fd) {
+      close();
+      mFd = fd;
+    }
+
+    /** Close the device file. */
+    void close() {
+      if (mFd >= 0) ::close(mFd);
+      mFd = -1;
+      reset();
+    }
+
+    /** Return the file descriptor, or -1 if the device is not open. */
+    int fd() const { return mFd; }
+
+    /** Start a write segment to addr. */
+    void beginWrite(uint8_t addr) {
+      if (mNumMessages >= kMaxMessages) submitEarly(mNumMessages);
+      struct i2c_msg& msg = mMessages[mNumMessages++];
+      msg.addr = addr;
+      msg.flags = 0;
+      msg.len = 0;
+      msg.buf = mTxBuffer + mTxLen;
+      mWriting = true;
+    }
+
+    /** Append a byte to the current write segment. Returns 0 if full. */
+    uint8_t write(uint8_t data) {
+      if (mTxLen >= kBufferSize && mWriting && mNumMessages > 1) {
+        // Make room by submitting all segments except the current one.
+        submitEarly(mNumMessages - 1);
+      }
+      if (! mWriting || mOverflow || mTxLen >= kBufferSize) {
+        mOverflow = true;
+        return 0;
+      }
+      mTxBuffer[mTxLen++] = data;
+      mMessages[mNumMessages - 1].len++;
+      return 1;
+    }
+
+    /**
+     * Submit the pending segments if `sendStop` is true. Otherwise, keep them
+     * so that the next segment follows a repeated START.
+     *
+     * @return 0 upon success, 1 if a segment overflowed the TX buffer,
+     *    otherwise the status code of errnoToStatus(), including the errors
+     *    of the segments submitted early
+     */
+    uint8_t endWrite(bool sendStop) {
+      mWriting = false;
+      if (mOverflow) {
+        reset();
+        return 1;
+      }
+      return sendStop ? submit() : 0;
+    }
+
+    /**
+     * Append a read segment of `quantity` bytes and submit the transaction,
+     * because the caller needs the data immediately. The I2C_RDWR ioctl always
+     * ends with a STOP, so a following segment starts with a new START.
+     *
+     * @return `quantity` upon success, 0 otherwise
+     */
+    uint16_t requestFrom(uint8_t addr, uint16_t quantity) {
+      mWriting = false;
+      mRxLen = 0;
+      mRxIndex = 0;
+      if (mOverflow || quantity > kBufferSize) {
+        reset();
+        return 0;
+      }
+      if (mNumMessages >= kMaxMessages) submitEarly(mNumMessages);
+      struct i2c_msg& msg = mMessages[mNumMessages++];
+      msg.addr = addr;
+      msg.flags = I2C_M_RD;
+      msg.len = quantity;
+      msg.buf = mRxBuffer;
+      if (submit()) return 0;
+      mRxLen = quantity;
+      return quantity;
+    }
+
+    /** Read the next byte received by requestFrom(), or 0xff if none. */
+    uint8_t read() {
+      return (mRxIndex < mRxLen) ? mRxBuffer[mRxIndex++] : 0xff;
+    }
+
+    /**
+     * Submit the `count` messages directly as a single I2C_RDWR, without
+     * copying the data. The kernel does not report which segment failed, so
+     * the `index` of a failed transfer is 0.
+     */
+    TransferResult transfer(const Message* msgs, uint8_t count) {
+      if (count > I2C_RDWR_IOCTL_MAX_MSGS) {
+        return TransferResult{1, I2C_RDWR_IOCTL_MAX_MSGS};
+      }
+      uint8_t empty = findEmptyRead(msgs, count);
+      if (empty < count) return TransferResult{1, empty};
+      struct i2c_msg i2cMsgs[I2C_RDWR_IOCTL_MAX_MSGS];
+      for (uint8_t i = 0; i < count; ++i) {
+        i2cMsgs[i].addr = msgs[i].addr;
+        i2cMsgs[i].flags = (msgs[i].flags & Message::kRead) ? I2C_M_RD : 0;
+        i2cMsgs[i].len = msgs[i].len;
+        i2cMsgs[i].buf = msgs[i].buf;
+      }
+      uint8_t status = rdwr(i2cMsgs, count);
+      return TransferResult{status, (uint8_t) (status ? 0 : count)};
+    }
+
+    // Delete the copy constructor and assignment operator because this object
+    // owns the file descriptor.
+    LinuxI2cDev(const LinuxI2cDev&) = delete;
+    LinuxI2cDev& operator=(const LinuxI2cDev&) = delete;
+
+  private:
+    /** Discard the pending segments. */
+    void reset() {
+      mNumMessages = 0;
+      mTxLen = 0;
+      mWriting = false;
+      mOverflow = false;
+      mStatus = 0;
+    }
+
+    /**
+     * Submit the pending segments, if any. Nothing is submitted if a segment
+     * submitted early has already failed.
+     */
+    uint8_t submit() {
+      uint8_t status = mStatus ? mStatus : rdwr(mMessages, mNumMessages);
+      reset();
+      return status;
+    }
+
+    /**
+     * Submit the first `count` pending segments ahead of the others, which
+     * are moved to the front of mMessages and mTxBuffer. The first error is
+     * kept in mStatus.
+     */
+    void submitEarly(uint8_t count) {
+      if (! mStatus) mStatus = rdwr(mMessages, count);
+      uint16_t txLen = 0;
+      for (uint8_t i = count; i < mNumMessages; ++i) {
+        struct i2c_msg& msg = mMessages[i - count];
+        msg = mMessages[i];
+        memmove(mTxBuffer + txLen, msg.buf, msg.len);
+        msg.buf = mTxBuffer + txLen;
+        txLen += msg.len;
+      }
+      mNumMessages -= count;
+      mTxLen = txLen;
+    }
+
+    /** Perform the I2C_RDWR for the given segments. */
+    uint8_t rdwr(struct i2c_msg* msgs, uint8_t count) const {
+      if (count == 0) return 0;
+      if (mFd < 0) return 4;
+      struct i2c_rdwr_ioctl_data data;
+      data.msgs = msgs;
+      data.nmsgs = count;
+      return errnoToStatus(mRdwr(mFd, &data));
+    }
+
+  private:
+    RdwrFunction const mRdwr;
+    int mFd = -1;
+    struct i2c_msg mMessages[kMaxMessages];
+    uint8_t mNumMessages = 0;
+    uint16_t mTxLen = 0;
+    uint16_t mRxLen = 0;
+    uint16_t mRxIndex = 0;
+    bool mWriting = false;
+    bool mOverflow = false;
+    uint8_t mStatus = 0; // of the segments submitted early
+    uint8_t mTxBuffer[kBufferSize];
+    uint8_t mRxBuffer[kBufferSize];
+};
+
+/**
+ * An implementation of the AceWire interface over a Linux I2C adapter, using
+ * a LinuxI2cDev owned by the caller. This allows the same device drivers to
+ * run on microcontrollers and on Linux machines such as the Raspberry Pi.
+ *
+ * The interface is buffered like TwoWireInterface: beginTransmission() and
+ * write() only collect the bytes, and endTransmission() submits the whole
+ * transaction, including any previous segments which ended with `sendStop =
+ * false`, as a single I2C_RDWR ioctl(). The NACK of the address is therefore
+ * reported by endTransmission(), not by beginTransmission().
+ *
+ * The requestFrom() method submits the transaction immediately, so that read()
+ * can return the data. The usual "write register address, repeated START,
+ * read" sequence is therefore a single ioctl(). The kernel always ends the
+ * ioctl() with a STOP condition, so a segment which follows a read segment
+ * starts with a new START instead of a repeated START. The same happens where
+ * LinuxI2cDev must submit the earlier write segments of a long transaction
+ * ahead of time, e.g. between the pieces of a BulkTransfer larger than
+ * kBufferSize. The transfer() method has no such restriction.
+ */
+class LinuxI2cDevInterface {
+  public:
+    /**
+     * The `sendStop = false` of endTransmission() is honored, but not the one
+     * of requestFrom(), because the kernel ends every ioctl() with a STOP.
+     * Generic code which relies on repeated STARTs after a read must treat
+     * this interface like one without repeated START.
+     */
+    static const bool kSupportsRepeatedStart = false;
+
+    /** Data is collected by write() and sent by endTransmission(). */
+    static const bool kBuffered = true;
+
+    /** Size of the TX buffer of LinuxI2cDev. */
+    static const uint16_t kBufferSize = LinuxI2cDev::kBufferSize;
+
+    /** Maximum quantity of requestFrom(), the size of the RX buffer. */
+    static const uint16_t kMaxQuantity = LinuxI2cDev::kBufferSize;
+
+    /**
+     * The beginTransmission() method always returns 0. The NACK of the address
+     * is reported by endTransmission().
+     */
+    static const bool kReportsAddressNack = false;
+
+    /**
+     * Constructor.
+     * @param dev instance of LinuxI2cDev, opened by the caller
+     */
+    explicit LinuxI2cDevInterface(LinuxI2cDev& dev) : mDev(dev) {}
+
+    /** Initialize the interface. Currently does nothing. */
+    void begin() const {}
+
+    /** End the interface. Currently does nothing. */
+    void end() const {}
+
+    /**
+     * Start a new write segment to `addr`.
+     *
+     * @return always returns 0 because nothing is sent until
+     *    endTransmission()
+     */
+    uint8_t beginTransmission(uint8_t addr) const {
+      mDev.beginWrite(addr);
+      return 0;
+    }
+
+    /**
+     * Write data into the TX buffer.
+     *
+     * @return 1 upon success, 0 if the buffer is full
+     */
+    uint8_t write(uint8_t data) const {
+      return mDev.write(data);
+    }
+
+    /**
+     * Submit the transaction if `sendStop` is true. Otherwise, keep it so that
+     * the next segment is joined by a repeated START.
+     *
+     *  * 0: success
+     *  * 1: length too long for buffer
+     *  * 2: NACK received (address or data)
+     *  * 4: other error reported by the kernel
+     */
+    uint8_t endTransmission(bool sendStop = true) const {
+      return mDev.endWrite(sendStop);
+    }
+
+    /**
+     * Read `quantity` bytes from the device at `addr`, as the final segment
+     * of the pending transaction. The STOP condition is always sent, because
+     * the kernel ends every ioctl() with a STOP.
+     *
+     * @param addr I2C address
+     * @param quantity number of bytes to read, at most kMaxQuantity
+     * @param sendStop ignored, see above
+     *
+     * @return `quantity` upon success, 0 otherwise
+     */
+    uint16_t requestFrom(
+        uint8_t addr, uint16_t quantity, bool sendStop = true) const {
+      (void) sendStop;
+      return mDev.requestFrom(addr, quantity);
+    }
+
+    /** Read a byte from the RX buffer. */
+    uint8_t read() const {
+      return mDev.read();
+    }
+
+    /**
+     * Execute the array of `count` messages as a single I2C_RDWR ioctl(),
+     * reading and writing directly from and to the `buf` of each message. The
+     * kernel does not report which segment failed, so the `index` of a failed
+     * transfer is 0.
+     */
+    TransferResult transfer(const Message* msgs, uint8_t count) const {
+      return mDev.transfer(msgs, count);
+    }
+
+    /**
+     * Read up to `quantity` bytes (0 for no limit) from the device at `addr`,
+     * passing each byte to the `sink` functor until it returns false. See
+     * streamRead().
+     */
+    template <typename F>
+    uint32_t readInto(
+        uint8_t addr, uint16_t quantity, F&& sink, bool sendStop = true)
+        const {
+      return streamRead(*this, addr, quantity, sink, sendStop);
+    }
+
+    // Use default copy constructor and assignment operator.
+    LinuxI2cDevInterface(const LinuxI2cDevInterface&) = default;
+    LinuxI2cDevInterface& operator=(const LinuxI2cDevInterface&) = default;
+
+  private:
+    LinuxI2cDev& mDev;
+};
+
+}
+
+#endif // defined(__linux__)
+
+#endif
@@ -26,6 +26,7 @@ SOFTWARE.
 #define ACE_WIRE_MARPLE_WIRE_INTERFACE_H
 
 #include <stdint.h>
+#include "GenericTransfer.h"
 
 namespace ace_wire {
 
@@ -36,10 +37,38 @@ namespace ace_wire {
  * buffer whose sizes are defined by the end-user.
  *
  * @tparam T_WIRE underlying I2C class which will always be `SoftWire`
+ * @tparam T_BUFFER_SIZE size of the buffers given to `SoftWire::setRxBuffer()`
+ *    and `SoftWire::setTxBuffer()`, reported by kBufferSize (default 32)
  */
-template <typename T_WIRE>
-class MarpleWireInterface {
+template <typename T_WIRE, uint16_t T_BUFFER_SIZE = 32>
+class MarpleWireInterface :
+    public GenericTransfer<MarpleWireInterface<T_WIRE, T_BUFFER_SIZE>> {
   public:
+    /**
+     * The `sendStop = false` parameter of endTransmission() and requestFrom()
+     * is honored, so the next transaction begins with a repeated START.
+     */
+    static const bool kSupportsRepeatedStart = true;
+
+    /** Data is buffered, and sent to the bus by endTransmission(). */
+    static const bool kBuffered = true;
+
+    /** Size of the TX and RX buffers. */
+    static const uint16_t kBufferSize = T_BUFFER_SIZE;
+
+    /**
+     * Maximum quantity of requestFrom(), limited by the RX buffer and the
+     * 8-bit quantity of the underlying library.
+     */
+    static const uint16_t kMaxQuantity =
+        (T_BUFFER_SIZE < 255) ? T_BUFFER_SIZE : 255;
+
+    /**
+     * The beginTransmission() method always returns 0. The NACK of the address
+     * is reported by endTransmission().
+     */
+    static const bool kReportsAddressNack = false;
+
     /**
      * Constructor.
      * @param wire instance of `SoftWire`
@@ -93,15 +122,17 @@ class MarpleWireInterface {
      * Read bytes from the slave and store in buffer owned by SoftWire
      *
      * @param addr I2C address
-     * @param quantity number of bytes to read
+     * @param quantity number of bytes to read, at most 255
      * @param sendStop whether the STOP condition should be sent at end
      *
      * @return the value returned by the underlying SoftWire::requestFrom()
      * method, which will normally be 'quantity'.
      */
-    uint8_t requestFrom(uint8_t addr, uint8_t quantity, bool sendStop = true)
-        const {
-      return mWire.requestFrom(addr, quantity, (uint8_t) sendStop);
+    uint16_t requestFrom(
+        uint8_t addr, uint16_t quantity, bool sendStop = true) const {
+      // The underlying library supports only an 8-bit quantity.
+      if (quantity > 255) return 0;
+      return mWire.requestFrom(addr, (uint8_t) quantity, (uint8_t) sendStop);
     }
 
     /** Read byte from buffer. */
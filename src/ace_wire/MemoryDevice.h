@@ -0,0 +1,325 @@
+/*
+MIT License
+
+Copyright (c) 2022 Brian T. Park
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef ACE_WIRE_MEMORY_DEVICE_H
+#define ACE_WIRE_MEMORY_DEVICE_H
+
+#include <stdint.h>
+#include <Arduino.h> // millis()
+#include "WireTraits.h"
+
+namespace ace_wire {
+
+/**
+ * A driver for I2C memory devices such as the 24Cxx family of EEPROMs and the
+ * MB85RC family of FRAMs, using any of the AceWire interfaces (`T_WIREI`).
+ *
+ * The write() method accepts a buffer of arbitrary length, and splits it into
+ * separate write transactions at the page boundaries of the device (and at the
+ * `maxChunk` limit of buffered interfaces). An EEPROM starts its internal write
+ * cycle (typically 5-10 ms) after the STOP condition of each page write, and
+ * does not respond to its address until the cycle is complete. Instead of
+ * waiting for the worst case, this class uses ACK polling: it repeatedly sends
+ * the device address until the device responds with an ACK, so that the next
+ * transaction starts as soon as the device is ready. The polling happens
+ * lazily before the *next* transaction, so the caller is free to do other work
+ * while the last page is being written.
+ *
+ * The read() method uses a single sequential read transaction after setting
+ * the memory address. If the length exceeds the RX buffer of a buffered
+ * interface, the read is continued with additional requestFrom() calls
+ * separated by a repeated START, relying on the "current address read" feature
+ * of these devices, so the memory address is sent only once.
+ *
+ * Devices with 1-byte memory addresses larger than 256 bytes (e.g. 24C04 to
+ * 24C16), and devices with 2-byte memory addresses larger than 64 kiB (e.g.
+ * 24CM01), use the lower bits of the I2C address as the upper bits of the
+ * memory address. This is handled automatically.
+ *
+ * FRAM devices have no write cycle and no page size. Use a `pageSize` of 0 for
+ * those, which disables both the page splitting and the ACK polling.
+ *
+ * The methods return the status codes of endTransmission(), with the addition
+ * of a timeout code:
+ *
+ *  * 0: success
+ *  * 1: length too long for buffer
+ *  * 2: address send, NACK received
+ *  * 3: data send, NACK received
+ *  * 4: other twi error (lost bus arbitration, bus error, ..)
+ *  * 5: timeout while waiting for the write cycle to complete
+ *
+ * @tparam T_WIREI the AceWire interface class, e.g. SimpleWireInterface
+ */
+template <typename T_WIREI>
+class MemoryDevice {
+  public:
+    /** Status code returned if the write cycle does not complete in time. */
+    static const uint8_t kStatusTimeout = 5;
+
+    /**
+     * Constructor.
+     *
+     * @param wireInterface instance of the AceWire interface
+     * @param addr I2C address of the device, with the block select bits set to
+     *    0 (e.g. 0x50)
+     * @param addressSize number of bytes in the memory address, 1 (24C01 to
+     *    24C16) or 2 (24C32 and above, most FRAMs)
+     * @param pageSize size of the write page in bytes (e.g. 8, 16, 32, 64,
+     *    128, 256), or 0 for FRAM devices which have no pages
+     * @param maxChunk the maximum number of bytes which can be sent or
+     *    received in a single transaction by `T_WIREI`, including the memory
+     *    address bytes. This is the size of the TX/RX buffer for buffered
+     *    interfaces (e.g. 32 for TwoWireInterface on AVR), or 0 for
+     *    unbuffered interfaces (e.g. SimpleWireInterface) which have no limit.
+     *    Must be larger than `addressSize`, otherwise write() returns 1.
+     *    Defaults to WireTraits<T_WIREI>::kBufferSize.
+     * @param writeTimeoutMillis maximum duration of the write cycle
+     */
+    explicit MemoryDevice(
+        const T_WIREI& wireInterface,
+        uint8_t addr,
+        uint8_t addressSize,
+        uint16_t pageSize,
+        uint16_t maxChunk = WireTraits<T_WIREI>::kBufferSize,
+        uint16_t writeTimeoutMillis = 10
+    ) :
+        mWireInterface(wireInterface),
+        mAddr(addr),
+        mAddressSize(addressSize),
+        mPageSize(pageSize),
+        mMaxChunk(maxChunk),
+        mWriteTimeoutMillis(writeTimeoutMillis)
+    {}
+
+    /**
+     * Write `len` bytes from `buf` to the memory location `memAddr`. The data
+     * is split at page boundaries, and the method waits for the write cycle of
+     * each page (except the last one) using ACK polling.
+     *
+     * @return 0 upon success, 1 if `maxChunk` has no room for a data byte
+     *    after the memory address, otherwise the status code described in the
+     *    class documentation
+     */
+    uint8_t write(uint32_t memAddr, const uint8_t* buf, uint16_t len) {
+      if (mMaxChunk != 0 && mMaxChunk <= mAddressSize) return 1;
+
+      while (len) {
+        uint16_t n = writeChunkSize(memAddr, len);
+        uint8_t status = writeChunk(memAddr, buf, n);
+        if (status) return status;
+
+        memAddr += n;
+        buf += n;
+        len -= n;
+      }
+      return 0;
+    }
+
+    /**
+     * Read `len` bytes from memory location `memAddr` into `buf` using a
+     * sequential read.
+     *
+     * @return 0 upon success, otherwise the status code described in the class
+     *    documentation
+     */
+    uint8_t read(uint32_t memAddr, uint8_t* buf, uint16_t len) {
+      while (len) {
+        // A sequential read wraps around at the end of the block selected by
+        // the device address, so each block needs its own address phase.
+        uint32_t blockRemaining = blockSize() - (memAddr & (blockSize() - 1));
+        uint16_t n = (blockRemaining < len) ? (uint16_t) blockRemaining : len;
+        uint8_t status = readBlock(memAddr, buf, n);
+        if (status) return status;
+
+        memAddr += n;
+        buf += n;
+        len -= n;
+      }
+      return 0;
+    }
+
+    /**
+     * Wait until the device has finished its internal write cycle, by sending
+     * its address repeatedly until it responds with an ACK. Returns
+     * immediately if no write is pending. Normally called automatically before
+     * each transaction, but can be called explicitly, e.g. before powering
+     * down.
+     *
+     * @return 0 upon success, kStatusTimeout if the device did not respond
+     *    within `writeTimeoutMillis`
+     */
+    uint8_t waitForReady() {
+      if (! mWritePending) return 0;
+
+      uint16_t startMillis = millis();
+      while (probe(mAddr)) {
+        if ((uint16_t) ((uint16_t) millis() - startMillis)
+            >= mWriteTimeoutMillis) {
+          return kStatusTimeout;
+        }
+      }
+      mWritePending = false;
+      return 0;
+    }
+
+    /**
+     * Return true if a write cycle may still be in progress, i.e. the last
+     * write has not been followed by a successful waitForReady().
+     */
+    bool isWritePending() const { return mWritePending; }
+
+    // Use default copy constructor. Delete the assignment operator because it
+    // cannot work with constant fields.
+    MemoryDevice(const MemoryDevice&) = default;
+    MemoryDevice& operator=(const MemoryDevice&) = delete;
+
+  private:
+    /** Maximum quantity of a single requestFrom(), at most maxChunk. */
+    static uint16_t maxQuantity(uint16_t maxChunk) {
+      uint16_t limit = WireTraits<T_WIREI>::kMaxQuantity;
+      return (maxChunk != 0 && maxChunk < limit) ? maxChunk : limit;
+    }
+
+    /** Number of bytes addressable through a single device address. */
+    uint32_t blockSize() const {
+      return (uint32_t) 1 << (8 * mAddressSize);
+    }
+
+    /** The I2C address, including the block select bits for memAddr. */
+    uint8_t deviceAddress(uint32_t memAddr) const {
+      return mAddr | ((memAddr >> (8 * mAddressSize)) & 0x07);
+    }
+
+    /** Size of the next write transaction, starting at memAddr. */
+    uint16_t writeChunkSize(uint32_t memAddr, uint16_t len) const {
+      uint16_t n = len;
+      if (mPageSize) {
+        uint16_t pageRemaining = mPageSize - (memAddr % mPageSize);
+        if (pageRemaining < n) n = pageRemaining;
+      }
+      if (mMaxChunk) {
+        uint16_t chunkRemaining = mMaxChunk - mAddressSize;
+        if (chunkRemaining < n) n = chunkRemaining;
+      }
+      return n;
+    }
+
+    /**
+     * Send the address of the device and check for ACK. This works for both
+     * unbuffered interfaces (where beginTransmission() detects the NACK) and
+     * buffered interfaces (where endTransmission() detects the NACK).
+     */
+    uint8_t probe(uint8_t addr) const {
+      uint8_t status = mWireInterface.beginTransmission(addr);
+      uint8_t endStatus = mWireInterface.endTransmission();
+      return status ? 2 : endStatus;
+    }
+
+    /**
+     * Send the device address and the memory address, leaving the transaction
+     * open for either more data bytes or a repeated START. Upon failure, the
+     * transaction is closed with a STOP condition.
+     */
+    uint8_t beginMemory(uint32_t memAddr) const {
+      uint8_t status = mWireInterface.beginTransmission(
+          deviceAddress(memAddr));
+      if (status) {
+        mWireInterface.endTransmission();
+        return 2;
+      }
+
+      if (mAddressSize == 2) {
+        status = mWireInterface.write((uint8_t) (memAddr >> 8)) ? 0 : 3;
+      }
+      if (status == 0) {
+        status = mWireInterface.write((uint8_t) memAddr) ? 0 : 3;
+      }
+      if (status) mWireInterface.endTransmission();
+      return status;
+    }
+
+    /** Write a chunk which does not cross a page boundary. */
+    uint8_t writeChunk(uint32_t memAddr, const uint8_t* buf, uint16_t n) {
+      uint8_t status = waitForReady();
+      if (status) return status;
+
+      status = beginMemory(memAddr);
+      if (status) return status;
+
+      for (uint16_t i = 0; status == 0 && i < n; ++i) {
+        if (! mWireInterface.write(buf[i])) status = 3;
+      }
+      uint8_t endStatus = mWireInterface.endTransmission();
+      if (status == 0) status = endStatus;
+
+      // FRAM devices have no write cycle.
+      if (status == 0 && mPageSize) mWritePending = true;
+      return status;
+    }
+
+    /** Read from a single block, using one address phase. */
+    uint8_t readBlock(uint32_t memAddr, uint8_t* buf, uint16_t n) {
+      uint8_t status = waitForReady();
+      if (status) return status;
+
+      status = beginMemory(memAddr);
+      if (status) return status;
+      status = mWireInterface.endTransmission(false);
+      if (status) return status;
+
+      // Each requestFrom() after the first continues from the current address
+      // of the device.
+      uint8_t devAddr = deviceAddress(memAddr);
+      uint16_t maxRead = maxQuantity(mMaxChunk);
+      while (n) {
+        uint16_t quantity = (n < maxRead) ? n : maxRead;
+        n -= quantity;
+        bool sendStop = (n == 0);
+        uint16_t received = mWireInterface.requestFrom(
+            devAddr, quantity, sendStop);
+        if (received == 0) {
+          if (! sendStop) endRead(mWireInterface, devAddr);
+          return 2;
+        }
+        for (uint16_t i = 0; i < quantity; ++i) {
+          *buf++ = mWireInterface.read();
+        }
+      }
+      return 0;
+    }
+
+  private:
+    T_WIREI mWireInterface; // copied by value
+    uint8_t const mAddr;
+    uint8_t const mAddressSize;
+    uint16_t const mPageSize;
+    uint16_t const mMaxChunk;
+    uint16_t const mWriteTimeoutMillis;
+    bool mWritePending = false;
+};
+
+}
+
+#endif
@@ -0,0 +1,151 @@
+/*
+MIT License
+
+Copyright (c) 2022 Brian T. Park
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef ACE_WIRE_MESSAGE_H
+#define ACE_WIRE_MESSAGE_H
+
+#include <stdint.h>
+#include "WireTraits.h"
+
+namespace ace_wire {
+
+/**
+ * A single read or write segment of a combined I2C transaction, similar to
+ * the `struct i2c_msg` of the Linux i2c-dev interface. An array of these is
+ * executed by the transfer() method of the interface classes.
+ */
+struct Message {
+  /** Flag for a read segment. A write segment has no flag. */
+  static const uint8_t kRead = 0x01;
+
+  /** I2C address of the device. */
+  uint8_t addr;
+
+  /** Zero or more flags, e.g. kRead. */
+  uint8_t flags;
+
+  /** Number of bytes to write or read. */
+  uint16_t len;
+
+  /**
+   * The bytes to write, or the destination of the bytes read. This is not
+   * `const` so that a single type can be used for both directions, as in
+   * Linux.
+   */
+  uint8_t* buf;
+};
+
+/** The result of a transfer() of an array of Message. */
+struct TransferResult {
+  /**
+   * 0 upon success, otherwise the status code of endTransmission() of the
+   * first failed message:
+   *
+   *  * 1: length too long for buffer
+   *  * 2: address send, NACK received
+   *  * 3: data send, NACK received
+   *  * 4: other twi error (lost bus arbitration, bus error, ..)
+   *  * 5: timeout
+   */
+  uint8_t status;
+
+  /** Index of the first failed message, or the message count upon success. */
+  uint8_t index;
+};
+
+/**
+ * Return the index of the first read message in `msgs` with a length of 0, or
+ * `count` if there is none. The master must receive at least one byte after
+ * the address of a read, so such a message cannot be executed, and the
+ * transfer() methods reject it with status 1.
+ */
+inline uint8_t findEmptyRead(const Message* msgs, uint8_t count) {
+  for (uint8_t i = 0; i < count; ++i) {
+    if ((msgs[i].flags & Message::kRead) && msgs[i].len == 0) return i;
+  }
+  return count;
+}
+
+/**
+ * Execute the `count` messages in `msgs` on `wireInterface`, joined by
+ * repeated START conditions, with a single STOP condition after the last
+ * message (or after the first failed message). This is the implementation of
+ * the transfer() method of the interface classes which have no native support
+ * for combined transactions.
+ *
+ * Interfaces which do not support repeated START (see WireTraits) send a STOP
+ * condition between the messages instead.
+ *
+ * A message which exceeds the buffer of the interface, or a read message of
+ * length 0, fails with status 1 before anything is sent.
+ */
+template <typename T_WIREI>
+TransferResult transferMessages(
+    const T_WIREI& wireInterface, const Message* msgs, uint8_t count) {
+  // Check the lengths before touching the bus, so that a message which can
+  // never succeed does not leave a partial transaction behind.
+  for (uint8_t i = 0; i < count; ++i) {
+    uint16_t limit = (msgs[i].flags & Message::kRead)
+        ? (uint16_t) WireTraits<T_WIREI>::kMaxQuantity
+        : (uint16_t) WireTraits<T_WIREI>::kBufferSize;
+    if (limit && msgs[i].len > limit) return TransferResult{1, i};
+  }
+  uint8_t empty = findEmptyRead(msgs, count);
+  if (empty < count) return TransferResult{1, empty};
+
+  for (uint8_t i = 0; i < count; ++i) {
+    const Message& msg = msgs[i];
+    bool sendStop = (i + 1 == count)
+        || ! WireTraits<T_WIREI>::kSupportsRepeatedStart;
+    uint8_t status = 0;
+
+    if (msg.flags & Message::kRead) {
+      if (wireInterface.requestFrom(msg.addr, msg.len, sendStop) == 0) {
+        // Terminate a read which did not send its own STOP.
+        if (! sendStop) endRead(wireInterface, msg.addr);
+        status = 2;
+      } else {
+        for (uint16_t j = 0; j < msg.len; ++j) {
+          msg.buf[j] = wireInterface.read();
+        }
+      }
+    } else {
+      if (wireInterface.beginTransmission(msg.addr)) status = 2;
+      for (uint16_t j = 0; status == 0 && j < msg.len; ++j) {
+        if (! wireInterface.write(msg.buf[j])) status = 3;
+      }
+      // Always terminate the transaction with a STOP upon failure.
+      uint8_t endStatus = wireInterface.endTransmission(
+          status ? true : sendStop);
+      if (status == 0) status = endStatus;
+    }
+
+    if (status) return TransferResult{status, i};
+  }
+  return TransferResult{0, count};
+}
+
+}
+
+#endif
@@ -0,0 +1,394 @@
+/*
+MIT License
+
+Copyright (c) 2022 Brian T. Park
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+
+#ifndef ACE_WIRE_POLL_SCHEDULER_H
+#define ACE_WIRE_POLL_SCHEDULER_H
+
+#include <stdint.h>
+#include <string.h> // memcpy()
+#include <Arduino.h> // millis()
+#include "WireTraits.h"
+
+namespace ace_wire {
+
+/** Statistics of a PollScheduler. */
+struct PollStats {
+  /** Number of burst read transactions. */
+  uint32_t bursts;
+
+  /** Number of bytes received by the burst reads. */
+  uint32_t bytesRead;
+
+  /**
+   * Number of subscriptions updated by a burst which was started for another
+   * subscription, i.e. the transactions saved by merging.
+   */
+  uint32_t merged;
+
+  /** Number of get() calls served from the cache. */
+  uint32_t cacheHits;
+
+  /** Number of burst reads which failed. */
+  uint32_t failures;
+};
+
+/**
+ * Poll ranges of registers of several devices at different rates, using any
+ * AceWire interface (`T_WIREI`), with as few transactions as possible.
+ *
+ * Each consumer subscribes to a range of registers of a device, with a
+ * polling period, and a time-to-live (TTL) of the cached data. The poll()
+ * method, called from the global `loop()`, reads the subscriptions which are
+ * due. The ranges of the other subscriptions of the same device which overlap
+ * or are adjacent (or separated by at most `maxGap` registers) are merged into
+ * a single burst read, as long as they are also due, and a subscription whose
+ * range lies entirely inside the burst is refreshed for free. Each received
+ * byte is copied directly into the cache of every subscription which contains
+ * its register, so no receive buffer is needed.
+ *
+ * The data of a subscription is retrieved by get(), which is served from the
+ * cache while its age is less than the TTL, and triggers an immediate burst
+ * read otherwise. A subscription with a period of 0 is never polled, and is
+ * read only on demand by get().
+ *
+ * The `byteBudget` of poll() bounds the bus time spent in a single iteration
+ * of `loop()`. The bursts which do not fit are deferred to the next call, and
+ * the subscriptions are serviced in round-robin order so that none of them
+ * starves. The first burst of each call is always executed, even if it
+ * exceeds the budget, so that progress is guaranteed.
+ *
+ * The burst read writes the register address (1 byte), then reads the range
+ * with a repeated START, which is the register access protocol of most
+ * sensors with auto-incrementing register addresses.
+ *
+ * @tparam T_WIREI the AceWire interface class, e.g. TwoWireInterface
+ * @tparam T_MAX_SUBSCRIPTIONS maximum number of subscriptions, at most 32
+ *    (default 8)
+ * @tparam T_CACHE_SIZE total number of bytes of the cached data of all
+ *    subscriptions (default 64)
+ */
+template <
+    typename T_WIREI,
+    uint8_t T_MAX_SUBSCRIPTIONS = 8,
+    uint16_t T_CACHE_SIZE = 64
+>
+class PollScheduler {
+  static_assert(T_MAX_SUBSCRIPTIONS <= 32,
+      "T_MAX_SUBSCRIPTIONS must be at most 32");
+
+  public:
+    /** Returned by subscribe() if there is no room for the subscription. */
+    static const uint8_t kInvalidId = 0xFF;
+
+    /** Status of a subscription which has never been read. */
+    static const uint8_t kStatusNoData = 0xFF;
+
+    /**
+     * Constructor.
+     *
+     * @param wireInterface instance of the AceWire interface
+     * @param maxGap maximum number of unused registers between 2 ranges which
+     *    are still merged into a single burst. The registers in the gap are
+     *    read and discarded. (default 0, only adjacent or overlapping ranges)
+     */
+    explicit PollScheduler(const T_WIREI& wireInterface, uint8_t maxGap = 0) :
+        mWireInterface(wireInterface),
+        mMaxGap(maxGap)
+    {
+      resetStats();
+    }
+
+    /**
+     * Subscribe to `len` registers starting at `reg` of the device at `addr`.
+     *
+     * @param addr I2C address of the device
+     * @param reg first register
+     * @param len number of registers, at least 1
+     * @param periodMillis polling period, or 0 to read only on demand
+     * @param ttlMillis maximum age of the cached data returned by get()
+     *
+     * @return the id of the subscription, or kInvalidId if the maximum number
+     *    of subscriptions or the cache size would be exceeded, or if `len` is
+     *    larger than a single requestFrom() of the interface can read
+     *    (WireTraits::kMaxQuantity)
+     */
+    uint8_t subscribe(
+        uint8_t addr, uint8_t reg, uint8_t len,
+        uint16_t periodMillis, uint16_t ttlMillis) {
+      if (mNumSubscriptions >= T_MAX_SUBSCRIPTIONS) return kInvalidId;
+      if (len == 0 || (uint16_t) reg + len > 256) return kInvalidId;
+      if (len > kMaxBurst) return kInvalidId;
+      if (len > T_CACHE_SIZE - mCacheUsed) return kInvalidId;
+
+      Subscription& s = mSubscriptions[mNumSubscriptions];
+      s.addr = addr;
+      s.reg = reg;
+      s.len = len;
+      s.offset = mCacheUsed;
+      s.periodMillis = periodMillis;
+      s.ttlMillis = ttlMillis;
+      s.updateMillis = 0;
+      s.status = kStatusNoData;
+      s.hasData = false;
+      mCacheUsed += len;
+      return mNumSubscriptions++;
+    }
+
+    /**
+     * Read the subscriptions which are due, merging them into bursts, until
+     * the `byteBudget` is exhausted.
+     *
+     * @param byteBudget maximum number of bytes to read in this call, not
+     *    counting the first burst (default: no limit)
+     * @return the number of burst reads
+     */
+    uint8_t poll(uint16_t byteBudget = 0xFFFF) {
+      uint32_t now = millis();
+      uint8_t bursts = 0;
+      for (uint8_t n = 0; n < mNumSubscriptions; ++n) {
+        uint8_t id = mNext;
+        if (isDue(id, now)) {
+          uint8_t lo;
+          uint16_t end;
+          uint32_t members = buildGroup(id, now, lo, end);
+          uint16_t len = end - lo;
+          if (bursts && len > byteBudget) break;
+
+          readBurst(id, members, lo, len, now);
+          byteBudget = (len < byteBudget) ? byteBudget - len : 0;
+          bursts++;
+        }
+        mNext = (id + 1 >= mNumSubscriptions) ? 0 : id + 1;
+      }
+      return bursts;
+    }
+
+    /**
+     * Copy the data of subscription `id` into `buf`. The data comes from the
+     * cache if it is younger than the TTL of the subscription, otherwise it is
+     * read immediately, merged with the other subscriptions which are due.
+     *
+     * @param id id of the subscription
+     * @param buf destination buffer, at least the `len` of the subscription
+     * @return 0 upon success, otherwise the status code of the burst read
+     */
+    uint8_t get(uint8_t id, uint8_t* buf) {
+      if (id >= mNumSubscriptions) return kStatusNoData;
+      Subscription& s = mSubscriptions[id];
+      uint32_t now = millis();
+      if (s.hasData && s.status == 0 && now - s.updateMillis < s.ttlMillis) {
+        mStats.cacheHits++;
+      } else {
+        uint8_t lo;
+        uint16_t end;
+        uint32_t members = buildGroup(id, now, lo, end);
+        readBurst(id, members, lo, end - lo, now);
+        if (s.status) return s.status;
+      }
+      memcpy(buf, mCache + s.offset, s.len);
+      return 0;
+    }
+
+    /**
+     * Return the cached data of subscription `id`, which may be stale or
+     * never read (see isFresh() and status()).
+     */
+    const uint8_t* data(uint8_t id) const {
+      return mCache + mSubscriptions[id].offset;
+    }
+
+    /**
+     * Return true if the cached data of subscription `id` was read
+     * successfully less than its TTL ago.
+     */
+    bool isFresh(uint8_t id) const {
+      const Subscription& s = mSubscriptions[id];
+      return s.hasData && s.status == 0
+          && (uint32_t) (millis() - s.updateMillis) < s.ttlMillis;
+    }
+
+    /**
+     * Return the status of the last read of subscription `id`, or
+     * kStatusNoData if it was never read.
+     */
+    uint8_t status(uint8_t id) const { return mSubscriptions[id].status; }
+
+    /** Return the millis() of the last read of subscription `id`. */
+    uint32_t updateMillis(uint8_t id) const {
+      return mSubscriptions[id].updateMillis;
+    }
+
+    /** Return the statistics. */
+    const PollStats& stats() const { return mStats; }
+
+    /** Clear the statistics. */
+    void resetStats() {
+      mStats.bursts = 0;
+      mStats.bytesRead = 0;
+      mStats.merged = 0;
+      mStats.cacheHits = 0;
+      mStats.failures = 0;
+    }
+
+    // Use default copy constructor. Delete the assignment operator because it
+    // cannot work with constant fields.
+    PollScheduler(const PollScheduler&) = default;
+    PollScheduler& operator=(const PollScheduler&) = delete;
+
+  private:
+    struct Subscription {
+      uint8_t addr;
+      uint8_t reg;
+      uint8_t len;
+      uint16_t offset;
+      uint16_t periodMillis;
+      uint16_t ttlMillis;
+      uint32_t updateMillis;
+      uint8_t status;
+      bool hasData;
+    };
+
+    /** Maximum length of a burst, limited by the interface. */
+    static const uint16_t kMaxBurst =
+        (WireTraits<T_WIREI>::kMaxQuantity < 256)
+            ? WireTraits<T_WIREI>::kMaxQuantity : 256;
+
+    /** Return true if subscription `id` should be polled at `now`. */
+    bool isDue(uint8_t id, uint32_t now) const {
+      const Subscription& s = mSubscriptions[id];
+      if (s.periodMillis == 0) return false;
+      if (s.status == kStatusNoData) return true;
+      return (uint32_t) (now - s.updateMillis) >= s.periodMillis;
+    }
+
+    /**
+     * Find the subscriptions which can be read in the same burst as `seed`.
+     * Another subscription of the same device joins if its range is inside
+     * the burst, or if it is due and its range is within `mMaxGap` of the
+     * burst, and the burst does not become too long.
+     *
+     * @param lo set to the first register of the burst
+     * @param end set to the register after the last register of the burst
+     * @return the bit mask of the member subscriptions
+     */
+    uint32_t buildGroup(uint8_t seed, uint32_t now, uint8_t& lo, uint16_t& end)
+        const {
+      const Subscription& first = mSubscriptions[seed];
+      uint32_t members = (uint32_t) 1 << seed;
+      lo = first.reg;
+      end = (uint16_t) first.reg + first.len;
+
+      bool changed = true;
+      while (changed) {
+        changed = false;
+        for (uint8_t i = 0; i < mNumSubscriptions; ++i) {
+          if (members & ((uint32_t) 1 << i)) continue;
+          const Subscription& s = mSubscriptions[i];
+          if (s.addr != first.addr) continue;
+
+          uint16_t sEnd = (uint16_t) s.reg + s.len;
+          bool inside = (s.reg >= lo && sEnd <= end);
+          bool near = ((uint16_t) s.reg <= end + mMaxGap
+              && sEnd + mMaxGap >= lo);
+          if (! inside && ! (near && isDue(i, now))) continue;
+
+          uint8_t newLo = (s.reg < lo) ? s.reg : lo;
+          uint16_t newEnd = (sEnd > end) ? sEnd : end;
+          if (newEnd - newLo > kMaxBurst) continue;
+
+          members |= (uint32_t) 1 << i;
+          if (newLo != lo || newEnd != end) changed = true;
+          lo = newLo;
+          end = newEnd;
+        }
+      }
+      return members;
+    }
+
+    /**
+     * Read `len` registers starting at `lo` in a single transaction, and copy
+     * each byte into the cache of the `members` which contain it.
+     */
+    void readBurst(
+        uint8_t seed, uint32_t members, uint8_t lo, uint16_t len,
+        uint32_t now) {
+      uint8_t addr = mSubscriptions[seed].addr;
+      uint8_t status = 0;
+      mStats.bursts++;
+
+      if (mWireInterface.beginTransmission(addr)) {
+        mWireInterface.endTransmission();
+        status = 2;
+      } else if (! mWireInterface.write(lo)) {
+        mWireInterface.endTransmission();
+        status = 3;
+      } else {
+        status = mWireInterface.endTransmission(false);
+      }
+      if (status == 0 && mWireInterface.requestFrom(addr, len) == 0) {
+        status = 2;
+      }
+
+      if (status == 0) {
+        for (uint16_t i = 0; i < len; ++i) {
+          uint8_t data = mWireInterface.read();
+          uint16_t reg = lo + i;
+          for (uint8_t id = 0; id < mNumSubscriptions; ++id) {
+            if (! (members & ((uint32_t) 1 << id))) continue;
+            const Subscription& s = mSubscriptions[id];
+            if (reg >= s.reg && reg < (uint16_t) s.reg + s.len) {
+              mCache[s.offset + (reg - s.reg)] = data;
+            }
+          }
+        }
+        mStats.bytesRead += len;
+      } else {
+        mStats.failures++;
+      }
+
+      for (uint8_t id = 0; id < mNumSubscriptions; ++id) {
+        if (! (members & ((uint32_t) 1 << id))) continue;
+        Subscription& s = mSubscriptions[id];
+        s.status = status;
+        s.updateMillis = now;
+        if (status == 0) s.hasData = true;
+        if (id != seed) mStats.merged++;
+      }
+    }
+
+  private:
+    T_WIREI mWireInterface; // copied by value
+    uint8_t const mMaxGap;
+    uint8_t mNumSubscriptions = 0;
+    uint8_t mNext = 0;
+    uint16_t mCacheUsed = 0;
+    PollStats mStats;
+    Subscription mSubscriptions[T_MAX_SUBSCRIPTIONS];
+    uint8_t mCache[T_CACHE_SIZE];
+};
+
+}
+
+#endif
@@ -0,0 +1,462 @@
+/*
+MIT License
+
+Copyright (c) 2022 Brian T. Park
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef ACE_WIRE_QUEUED_WIRE_INTERFACE_H
+#define ACE_WIRE_QUEUED_WIRE_INTERFACE_H
+
+#include <stdint.h>
+#include <Arduino.h> // yield()
+#include "SpscRing.h"
+#include "Message.h"
+#include "GenericTransfer.h"
+
+namespace ace_wire {
+
+/** A completion posted by WireQueue for a request submitted by submit(). */
+struct WireCompletion {
+  /** The tag given to submit(). */
+  uint8_t tag;
+
+  /** The status code of endTransmission(), or 2 if requestFrom() failed. */
+  uint8_t status;
+};
+
+/**
+ * A queue of I2C requests which are executed on the AceWire interface
+ * `T_WIREI` by a worker running on another core (e.g. the second core of an
+ * ESP32 or RP2040), or on another thread (e.g. a pthread under EpoxyDuino).
+ * The requests and the completions are passed through two lock-free SpscRing
+ * buffers, so the producer (normally the main loop) never blocks on the I2C
+ * bus unless it needs the result.
+ *
+ * The producer side has 2 APIs, which should be used from a single core:
+ *
+ *  * submit() and pollCompletion(), which are fully asynchronous
+ *  * the normal AceWire API through QueuedWireInterface
+ *
+ * The worker side calls runOnce() in a loop. Each request is a single segment
+ * (write or read) of a transaction. The worker executes the segments in order,
+ * so a segment submitted with `sendStop = false` is followed by a repeated
+ * START, even if the next segment is submitted later.
+ *
+ * The data of a write segment is copied into the queue. The data of a read
+ * segment is written directly to the buffer of the caller, which must remain
+ * valid until its completion has been received.
+ *
+ * @tparam T_WIREI the AceWire interface used by the worker, e.g.
+ *    SimpleWireInterface
+ * @tparam T_QUEUE_SIZE number of requests in the queue, a power of 2
+ * @tparam T_DATA_SIZE maximum number of bytes in a write segment, and in a
+ *    read segment of QueuedWireInterface
+ */
+template <
+    typename T_WIREI,
+    uint8_t T_QUEUE_SIZE = 8,
+    uint8_t T_DATA_SIZE = 32
+>
+class WireQueue {
+  public:
+    /** The AceWire interface used by the worker. */
+    typedef T_WIREI WireInterface;
+
+    /** Maximum number of bytes in a write segment. */
+    static const uint8_t kDataSize = T_DATA_SIZE;
+
+    /**
+     * Constructor.
+     * @param wireInterface instance of the AceWire interface used by the
+     *    worker
+     */
+    explicit WireQueue(const T_WIREI& wireInterface) :
+        mWireInterface(wireInterface)
+    {}
+
+    //-----------------------------------------------------------------------
+    // Producer side.
+    //-----------------------------------------------------------------------
+
+    /**
+     * Submit a single segment. A completion with `tag` is posted when the
+     * segment has been executed.
+     *
+     * @param msg the segment. For a write segment, the `buf` is copied into
+     *    the queue. For a read segment, the `buf` must remain valid until
+     *    the completion is received.
+     * @param sendStop whether the STOP condition is sent after the segment
+     * @param tag identifies the completion
+     *
+     * @return true upon success, false if the queue is full or a write
+     *    segment is longer than `T_DATA_SIZE`
+     */
+    bool submit(const Message& msg, bool sendStop, uint8_t tag) {
+      bool isRead = msg.flags & Message::kRead;
+      if (! isRead && msg.len > T_DATA_SIZE) return false;
+
+      Request* request = mRequests.reserve();
+      if (! request) return false;
+      request->addr = msg.addr;
+      request->flags = kNotify
+          | (isRead ? kRead : 0)
+          | (sendStop ? kStop : 0);
+      request->tag = tag;
+      request->len = msg.len;
+      if (isRead) {
+        request->readBuf = msg.buf;
+      } else {
+        for (uint8_t i = 0; i < msg.len; ++i) request->data[i] = msg.buf[i];
+      }
+      commitRequest();
+      return true;
+    }
+
+    /** Retrieve the oldest completion. Returns false if there is none. */
+    bool pollCompletion(WireCompletion& completion) {
+      return mCompletions.pop(completion);
+    }
+
+    /**
+     * Return the number of completions which were dropped because the
+     * completion ring was full.
+     */
+    uint16_t droppedCompletions() const {
+      return __atomic_load_n(&mDroppedCompletions, __ATOMIC_RELAXED);
+    }
+
+    /**
+     * Wait until the worker has executed all the submitted requests.
+     *
+     * @return the status of the first posted write of QueuedWireInterface
+     *    which failed since the last flush(), or 0
+     */
+    uint8_t flush() {
+      waitForWorker();
+      return __atomic_exchange_n(&mPostedStatus, 0, __ATOMIC_ACQ_REL);
+    }
+
+    /** Start a write segment for QueuedWireInterface. */
+    void beginWrite(uint8_t addr) {
+      mStaging.addr = addr;
+      mStaging.len = 0;
+      mOverflow = false;
+    }
+
+    /** Append a byte to the write segment. Returns 0 if full. */
+    uint8_t write(uint8_t data) {
+      if (mStaging.len >= T_DATA_SIZE) {
+        mOverflow = true;
+        return 0;
+      }
+      mStaging.data[mStaging.len++] = data;
+      return 1;
+    }
+
+    /**
+     * Queue the write segment. If `posted` is true, return immediately, and
+     * report the failure through flush(). Otherwise, wait for the result.
+     */
+    uint8_t endWrite(bool sendStop, bool posted) {
+      if (mOverflow) return 1;
+      mStaging.flags = (sendStop ? kStop : 0) | (posted ? kPosted : 0);
+      pushStaging();
+      if (posted) return 0;
+      waitForWorker();
+      return __atomic_load_n(&mLastStatus, __ATOMIC_RELAXED);
+    }
+
+    /**
+     * Queue a read segment of `quantity` bytes into the internal RX buffer,
+     * and wait for the result.
+     *
+     * @return `quantity` upon success, 0 otherwise
+     */
+    uint16_t requestFrom(uint8_t addr, uint16_t quantity, bool sendStop) {
+      mRxLen = 0;
+      mRxIndex = 0;
+      if (quantity > T_DATA_SIZE) return 0;
+
+      mStaging.addr = addr;
+      mStaging.flags = kRead | (sendStop ? kStop : 0);
+      mStaging.len = quantity;
+      mStaging.readBuf = mRxBuffer;
+      pushStaging();
+      waitForWorker();
+      if (__atomic_load_n(&mLastStatus, __ATOMIC_RELAXED)) return 0;
+      mRxLen = quantity;
+      return quantity;
+    }
+
+    /** Read the next byte received by requestFrom(), or 0xff if none. */
+    uint8_t read() {
+      return (mRxIndex < mRxLen) ? mRxBuffer[mRxIndex++] : 0xff;
+    }
+
+    //-----------------------------------------------------------------------
+    // Worker side.
+    //-----------------------------------------------------------------------
+
+    /** Return the AceWire interface used by the worker, e.g. for begin(). */
+    const T_WIREI& wireInterface() const { return mWireInterface; }
+
+    /**
+     * Execute the oldest request, if any. Call this repeatedly from the
+     * worker core or thread.
+     *
+     * @return true if a request was executed
+     */
+    bool runOnce() {
+      Request* request = mRequests.front();
+      if (! request) return false;
+
+      uint8_t status = execute(*request);
+      if (request->flags & kNotify) {
+        if (! mCompletions.push(WireCompletion{request->tag, status})) {
+          __atomic_store_n(&mDroppedCompletions,
+              (uint16_t) (mDroppedCompletions + 1), __ATOMIC_RELAXED);
+        }
+      }
+      if (status && (request->flags & kPosted)) {
+        uint8_t expected = 0;
+        __atomic_compare_exchange_n(&mPostedStatus, &expected, status,
+            false, __ATOMIC_RELAXED, __ATOMIC_RELAXED);
+      }
+      mRequests.pop();
+
+      // Publish the results of this request to the producer.
+      __atomic_store_n(&mLastStatus, status, __ATOMIC_RELAXED);
+      __atomic_store_n(&mCompleted, (uint8_t) (mCompleted + 1),
+          __ATOMIC_RELEASE);
+      return true;
+    }
+
+    // Delete the copy constructor and assignment operator because this object
+    // is shared by the producer and the worker.
+    WireQueue(const WireQueue&) = delete;
+    WireQueue& operator=(const WireQueue&) = delete;
+
+  private:
+    /** Read segment. */
+    static const uint8_t kRead = 0x01;
+
+    /** Send the STOP condition after the segment. */
+    static const uint8_t kStop = 0x02;
+
+    /** Post a completion for the segment. */
+    static const uint8_t kNotify = 0x04;
+
+    /** Record a failure of the segment for flush(). */
+    static const uint8_t kPosted = 0x08;
+
+    /** A segment in the queue. */
+    struct Request {
+      uint8_t addr;
+      uint8_t flags;
+      uint8_t tag;
+      uint16_t len;
+      uint8_t* readBuf;
+      uint8_t data[T_DATA_SIZE];
+    };
+
+    /** Publish the request returned by reserve(). */
+    void commitRequest() {
+      mRequests.commit();
+      mSubmitted++;
+    }
+
+    /** Copy the staging request into the queue, waiting for a free slot. */
+    void pushStaging() {
+      Request* request;
+      while (! (request = mRequests.reserve())) yield();
+      *request = mStaging;
+      commitRequest();
+    }
+
+    /** Wait until the worker has executed all submitted requests. */
+    void waitForWorker() const {
+      while (__atomic_load_n(&mCompleted, __ATOMIC_ACQUIRE) != mSubmitted) {
+        yield();
+      }
+    }
+
+    /** Execute a single segment on the worker. */
+    uint8_t execute(const Request& request) const {
+      bool sendStop = request.flags & kStop;
+      if (request.flags & kRead) {
+        if (mWireInterface.requestFrom(request.addr, request.len, sendStop)
+            == 0) {
+          if (! sendStop) endRead(mWireInterface, request.addr);
+          return 2;
+        }
+        for (uint16_t i = 0; i < request.len; ++i) {
+          request.readBuf[i] = mWireInterface.read();
+        }
+        return 0;
+      }
+
+      uint8_t status = mWireInterface.beginTransmission(request.addr) ? 2 : 0;
+      for (uint8_t i = 0; status == 0 && i < request.len; ++i) {
+        if (! mWireInterface.write(request.data[i])) status = 3;
+      }
+      // Always terminate the transaction with a STOP upon failure.
+      uint8_t endStatus = mWireInterface.endTransmission(
+          status ? true : sendStop);
+      return status ? status : endStatus;
+    }
+
+  private:
+    // Worker side.
+    T_WIREI mWireInterface; // copied by value
+    uint8_t mCompleted = 0;
+    uint8_t mLastStatus = 0;
+    uint8_t mPostedStatus = 0;
+    uint16_t mDroppedCompletions = 0;
+
+    // Shared.
+    SpscRing<Request, T_QUEUE_SIZE> mRequests;
+    SpscRing<WireCompletion, T_QUEUE_SIZE> mCompletions;
+
+    // Producer side.
+    uint8_t mSubmitted = 0;
+    bool mOverflow = false;
+    uint8_t mRxLen = 0;
+    uint8_t mRxIndex = 0;
+    Request mStaging;
+    uint8_t mRxBuffer[T_DATA_SIZE];
+};
+
+/**
+ * An implementation of the AceWire interface which queues the transactions to
+ * a WireQueue, to be executed by a worker on another core.
+ *
+ * If `T_POSTED` is true (the default), endTransmission() returns as soon as
+ * the write segment is queued. A failure is reported later by
+ * WireQueue::flush(). Helper classes which depend on the status of
+ * endTransmission(), such as the ACK polling of MemoryDevice, need `T_POSTED`
+ * set to false, which waits for the worker in endTransmission().
+ *
+ * The requestFrom() method always waits for the worker, because read() needs
+ * the data. Use WireQueue::submit() for fully asynchronous reads.
+ *
+ * @tparam T_QUEUE the WireQueue class
+ * @tparam T_POSTED return from endTransmission() without waiting for the
+ *    worker
+ */
+template <typename T_QUEUE, bool T_POSTED = true>
+class QueuedWireInterface :
+    public GenericTransfer<QueuedWireInterface<T_QUEUE, T_POSTED>> {
+  public:
+    /** Repeated START is supported if the worker's interface supports it. */
+    static const bool kSupportsRepeatedStart =
+        T_QUEUE::WireInterface::kSupportsRepeatedStart;
+
+    /** Data is collected by write() and queued by endTransmission(). */
+    static const bool kBuffered = true;
+
+    /** Size of the data buffer of a single queued segment. */
+    static const uint16_t kBufferSize = T_QUEUE::kDataSize;
+
+    /** Maximum quantity of requestFrom(), the size of the RX buffer. */
+    static const uint16_t kMaxQuantity = T_QUEUE::kDataSize;
+
+    /**
+     * The beginTransmission() method always returns 0. The NACK of the address
+     * is reported by endTransmission(), or by WireQueue::flush().
+     */
+    static const bool kReportsAddressNack = false;
+
+    /**
+     * Constructor.
+     * @param queue instance of WireQueue, shared with the worker
+     */
+    explicit QueuedWireInterface(T_QUEUE& queue) : mQueue(queue) {}
+
+    /**
+     * Initialize the interface. Currently does nothing. The begin() of the
+     * worker's interface should be called by the worker.
+     */
+    void begin() const {}
+
+    /** End the interface. Currently does nothing. */
+    void end() const {}
+
+    /**
+     * Start a write segment to `addr`.
+     *
+     * @return always returns 0 because nothing is sent until
+     *    endTransmission()
+     */
+    uint8_t beginTransmission(uint8_t addr) const {
+      mQueue.beginWrite(addr);
+      return 0;
+    }
+
+    /**
+     * Write data into the segment buffer.
+     *
+     * @return 1 upon success, 0 if the buffer is full
+     */
+    uint8_t write(uint8_t data) const {
+      return mQueue.write(data);
+    }
+
+    /**
+     * Queue the write segment, with a STOP condition if `sendStop` is true.
+     *
+     * @return 1 if the segment was too long for the buffer, always 0 if
+     *    `T_POSTED` is true, otherwise the status code of the
+     *    endTransmission() of the worker's interface
+     */
+    uint8_t endTransmission(bool sendStop = true) const {
+      return mQueue.endWrite(sendStop, T_POSTED);
+    }
+
+    /**
+     * Queue a read segment, and wait for the worker to execute it.
+     *
+     * @param addr I2C address
+     * @param quantity number of bytes to read, at most kMaxQuantity
+     * @param sendStop whether the STOP condition should be sent at end
+     *
+     * @return `quantity` upon success, 0 otherwise
+     */
+    uint16_t requestFrom(
+        uint8_t addr, uint16_t quantity, bool sendStop = true) const {
+      return mQueue.requestFrom(addr, quantity, sendStop);
+    }
+
+    /** Read a byte from the RX buffer. */
+    uint8_t read() const {
+      return mQueue.read();
+    }
+
+    // Use default copy constructor and assignment operator.
+    QueuedWireInterface(const QueuedWireInterface&) = default;
+    QueuedWireInterface& operator=(const QueuedWireInterface&) = default;
+
+  private:
+    T_QUEUE& mQueue;
+};
+
+}
+
+#endif
@@ -26,6 +26,7 @@ SOFTWARE.
 #define ACE_WIRE_RAEMOND_WIRE_INTERFACE_H
 
 #include <stdint.h>
+#include "GenericTransfer.h"
 
 namespace ace_wire {
 
@@ -35,11 +36,39 @@ namespace ace_wire {
  * AceWire API. The SoftWire class uses a 32-byte RX buffer and a 32-byte TX
  * buffer.
  *
+ * Since repeated START is not supported, the transfer() of GenericTransfer
+ * sends a STOP condition after every message instead, so a register read
+ * relies on the device keeping its register pointer across the STOP. The
+ * readInto() method sends a STOP after every piece of kMaxQuantity bytes.
+ *
  * @tparam T_WIRE underlying I2C class which will always be `SoftWire`
  */
 template <typename T_WIRE>
-class RaemondWireInterface {
+class RaemondWireInterface :
+    public GenericTransfer<RaemondWireInterface<T_WIRE>> {
   public:
+    /**
+     * The `sendStop = false` parameter of requestFrom() cannot be honored,
+     * because SoftWire provides no primitive to end a read without a STOP.
+     * The endTransmission() method does honor it.
+     */
+    static const bool kSupportsRepeatedStart = false;
+
+    /** Data is buffered, and sent to the bus by endTransmission(). */
+    static const bool kBuffered = true;
+
+    /** Size of the TX and RX buffers. */
+    static const uint16_t kBufferSize = 32;
+
+    /** Maximum quantity of requestFrom(), limited by the RX buffer. */
+    static const uint16_t kMaxQuantity = 32;
+
+    /**
+     * The beginTransmission() method always returns 0. The NACK of the address
+     * is reported by endTransmission().
+     */
+    static const bool kReportsAddressNack = false;
+
     /**
      * Constructor.
      * @param wire instance of `SoftWire`
@@ -94,16 +123,18 @@ class RaemondWireInterface {
      * Read bytes from the slave and store in buffer owned by SoftWire. The
      * `sendStop` is supposed to control whether the STOP condition should be
      * sent, but the SoftWire implementation does not provide this feature and
-     * always sends a STOP condition.
+     * always sends a STOP condition. The `quantity` must be at most 255.
      *
      * @return the value returned by the underlying SoftWire::requestFrom()
      * method, which will normally be 'quantity'.
      */
-    uint8_t requestFrom(uint8_t addr, uint8_t quantity, bool sendStop = true)
-        const {
+    uint16_t requestFrom(
+        uint8_t addr, uint16_t quantity, bool sendStop = true) const {
+      // The underlying library supports only an 8-bit quantity.
+      if (quantity > 255) return 0;
       (void) sendStop;
       // SoftWire does not provide a version with a sendStop parameter.
-      return mWire.requestFrom(addr, quantity);
+      return mWire.requestFrom(addr, (uint8_t) quantity);
     }
 
     /** Read byte from buffer. */
@@ -0,0 +1,400 @@
+/*
+MIT License
+
+Copyright (c) 2022 Brian T. Park
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+
+#ifndef ACE_WIRE_RATE_CONTROLLER_H
+#define ACE_WIRE_RATE_CONTROLLER_H
+
+#include <stdint.h>
+#include <Arduino.h> // millis()
+#include "SpeedProfile.h"
+
+namespace ace_wire {
+
+/**
+ * Access to the speed value of the profile entries used by RateController:
+ * DelayProfile (SimpleWireInterface, SimpleWireFastInterface) and
+ * ClockProfile (ClockSelector of TwoWireInterface).
+ */
+template <typename T_PROFILE>
+struct ProfileTraits;
+
+template <>
+struct ProfileTraits<DelayProfile> {
+  typedef uint8_t Value;
+  static void set(DelayProfile& profile, uint8_t value) {
+    profile.delayMicros = value;
+  }
+};
+
+template <>
+struct ProfileTraits<ClockProfile> {
+  typedef uint32_t Value;
+  static void set(ClockProfile& profile, uint32_t value) {
+    profile.clock = value;
+  }
+};
+
+/** Counters of a single device of RateController. */
+struct RateStats {
+  /** Number of transactions reported. */
+  uint32_t transactions;
+
+  /** Number of transactions which failed. */
+  uint32_t errors;
+
+  /**
+   * Number of address NACKs given to reportAddressNack(), which are counted
+   * in `transactions` and `errors` only if enabled in the constructor.
+   */
+  uint32_t addressNacks;
+
+  /** Number of times the speed was lowered. */
+  uint16_t stepDowns;
+
+  /** Number of times the speed was raised. */
+  uint16_t stepUps;
+};
+
+/** An entry in the history of speed changes of RateController. */
+struct RateChange {
+  /** Time of the change, from millis(). */
+  uint32_t millis;
+
+  /** I2C address of the device. */
+  uint8_t addr;
+
+  /** The new speed step of the device. */
+  uint8_t step;
+};
+
+/**
+ * Adjust the speed of each device at runtime from the outcome of its
+ * transactions, so that the bus runs at the highest speed that the wiring of
+ * a particular unit sustains, even as its cable length or temperature varies.
+ * Where SpeedCalibrator measures the speed once at commissioning, this class
+ * keeps tuning it in the field.
+ *
+ * The speed settings are abstracted as a "step" from 0 (slowest) to
+ * `numSteps - 1` (fastest), as in SpeedCalibrator. The `steps` table maps
+ * each step to the value stored in the table of per-device profiles
+ * (`T_PROFILE`), which is owned by the caller and shared with the interface:
+ *
+ *  * DelayProfile entries with the `delayMicros` of each step, for a custom
+ *    `T_PROFILE` of SimpleWireInterface or SimpleWireFastInterface which
+ *    calls findDelayMicros()
+ *  * ClockProfile entries with the `clock` of each step, for the ClockSelector
+ *    of TwoWireInterface
+ *
+ * The interfaces look up the profile of the device on every
+ * beginTransmission() and requestFrom(), so a new speed takes effect with the
+ * next transaction.
+ *
+ * The outcome of each transaction is given to report(), normally by
+ * AdaptiveWireInterface which observes the NACKs and other errors returned by
+ * the interface. Errors detected by the driver itself, such as a mismatch of
+ * the data read back or a bad checksum, are given to reportError().
+ *
+ * An address NACK is usually expected rather than a sign of a marginal link:
+ * an EEPROM does not acknowledge its address during its write cycle, and a
+ * driver may probe for a device which is absent. Therefore address NACKs are
+ * given to reportAddressNack(), which only counts them by default.
+ *
+ * The speed of a device is lowered by one step when `errorThreshold` errors
+ * are seen within a window of `errorWindow` transactions. It is raised by one
+ * step after a run of `cleanWindow` consecutive successful transactions. If
+ * the faster step fails before it has completed its own clean window, the
+ * clean window required before the next attempt is doubled (up to 16 times),
+ * so that a link at its limit does not oscillate between 2 steps.
+ *
+ * Devices which are not in the profile table are ignored.
+ *
+ * @tparam T_PROFILE DelayProfile or ClockProfile
+ * @tparam T_MAX_DEVICES maximum number of devices (default 8)
+ * @tparam T_HISTORY_SIZE number of speed changes kept in the history
+ *    (default 16)
+ */
+template <
+    typename T_PROFILE,
+    uint8_t T_MAX_DEVICES = 8,
+    uint8_t T_HISTORY_SIZE = 16
+>
+class RateController {
+  static_assert(T_HISTORY_SIZE > 0, "T_HISTORY_SIZE must be at least 1");
+
+  public:
+    /** Type of the speed values of `T_PROFILE`. */
+    typedef typename ProfileTraits<T_PROFILE>::Value Value;
+
+    /** Returned by step() for a device which is not in the profile table. */
+    static const uint8_t kNoStep = 0xFF;
+
+    /** Maximum doubling of the clean window after failed attempts. */
+    static const uint8_t kMaxBackoffShift = 4;
+
+    /**
+     * Constructor. The profile of every device is set to `initialStep`.
+     *
+     * @param profiles table of devices, owned by the caller and given to the
+     *    interface. Only the first `T_MAX_DEVICES` entries are controlled.
+     * @param numProfiles number of entries in `profiles`
+     * @param steps table of `numSteps` speed values (e.g. `delayMicros` or
+     *    `clock`), from the slowest to the fastest
+     * @param numSteps number of entries in `steps`, at least 1
+     * @param initialStep initial step of every device, e.g. the result of
+     *    SpeedCalibrator
+     * @param cleanWindow number of consecutive successful transactions before
+     *    the speed is raised (default 256)
+     * @param errorThreshold number of errors within `errorWindow` transactions
+     *    which lowers the speed (default 2)
+     * @param errorWindow number of transactions over which the errors are
+     *    counted (default 64)
+     * @param countAddressNacks if true, an address NACK is reported as a
+     *    failed transaction, for devices which always acknowledge their
+     *    address (default false)
+     */
+    explicit RateController(
+        T_PROFILE* profiles,
+        uint8_t numProfiles,
+        const Value* steps,
+        uint8_t numSteps,
+        uint8_t initialStep,
+        uint16_t cleanWindow = 256,
+        uint8_t errorThreshold = 2,
+        uint16_t errorWindow = 64,
+        bool countAddressNacks = false
+    ) :
+        mProfiles(profiles),
+        mNumDevices(
+            (numProfiles < T_MAX_DEVICES) ? numProfiles : T_MAX_DEVICES),
+        mSteps(steps),
+        mNumSteps(numSteps),
+        mCleanWindow(cleanWindow),
+        mErrorThreshold(errorThreshold ? errorThreshold : 1),
+        mErrorWindow(errorWindow),
+        mCountAddressNacks(countAddressNacks)
+    {
+      if (initialStep >= numSteps) initialStep = numSteps - 1;
+      for (uint8_t i = 0; i < mNumDevices; ++i) {
+        mDevices[i] = Device();
+        mDevices[i].step = initialStep;
+        ProfileTraits<T_PROFILE>::set(mProfiles[i], mSteps[initialStep]);
+      }
+    }
+
+    /**
+     * Report the outcome of a transaction with the device at `addr`, and
+     * change its speed if necessary.
+     */
+    void report(uint8_t addr, bool ok) {
+      uint8_t i = findDevice(addr);
+      if (i >= mNumDevices) return;
+
+      Device& device = mDevices[i];
+      device.stats.transactions++;
+      if (++device.windowCount >= mErrorWindow) {
+        device.windowCount = 0;
+        device.windowErrors = 0;
+      }
+
+      if (ok) {
+        device.cleanRun++;
+        if (device.probing && device.cleanRun >= mCleanWindow) {
+          // The faster step has proven itself.
+          device.probing = false;
+          device.backoffShift = 0;
+        }
+        if (device.step + 1 < mNumSteps
+            && device.cleanRun >= ((uint32_t) mCleanWindow
+                << device.backoffShift)) {
+          device.stats.stepUps++;
+          device.probing = true;
+          changeStep(i, device.step + 1);
+        }
+        return;
+      }
+
+      device.stats.errors++;
+      device.cleanRun = 0;
+      if (++device.windowErrors < mErrorThreshold) return;
+
+      device.windowErrors = 0;
+      if (device.probing && device.backoffShift < kMaxBackoffShift) {
+        device.backoffShift++;
+      }
+      device.probing = false;
+      if (device.step > 0) {
+        device.stats.stepDowns++;
+        changeStep(i, device.step - 1);
+      }
+    }
+
+    /**
+     * Report an error detected by the driver for the device at `addr`, e.g.
+     * data read back which differs from what was written, or a PEC error.
+     */
+    void reportError(uint8_t addr) { report(addr, false); }
+
+    /**
+     * Report that the device at `addr` did not acknowledge its address. It is
+     * counted in RateStats::addressNacks, and reported as a failed
+     * transaction only if `countAddressNacks` was set in the constructor.
+     */
+    void reportAddressNack(uint8_t addr) {
+      uint8_t i = findDevice(addr);
+      if (i >= mNumDevices) return;
+
+      mDevices[i].stats.addressNacks++;
+      if (mCountAddressNacks) report(addr, false);
+    }
+
+    /**
+     * Set the step of the device at `addr`, e.g. after a recalibration.
+     * Returns false if the device is not in the profile table.
+     */
+    bool setStep(uint8_t addr, uint8_t step) {
+      uint8_t i = findDevice(addr);
+      if (i >= mNumDevices) return false;
+      if (step >= mNumSteps) step = mNumSteps - 1;
+
+      mDevices[i].backoffShift = 0;
+      mDevices[i].probing = false;
+      changeStep(i, step);
+      return true;
+    }
+
+    /** Return the current step of the device at `addr`, or kNoStep. */
+    uint8_t step(uint8_t addr) const {
+      uint8_t i = findDevice(addr);
+      return (i < mNumDevices) ? mDevices[i].step : kNoStep;
+    }
+
+    /**
+     * Return the current speed value of the device at `addr`, or
+     * `defaultValue` if the device is not in the profile table.
+     */
+    Value value(uint8_t addr, Value defaultValue = 0) const {
+      uint8_t i = findDevice(addr);
+      return (i < mNumDevices) ? mSteps[mDevices[i].step] : defaultValue;
+    }
+
+    /**
+     * Return the counters of the device at `addr`, or nullptr if the device
+     * is not in the profile table.
+     */
+    const RateStats* stats(uint8_t addr) const {
+      uint8_t i = findDevice(addr);
+      return (i < mNumDevices) ? &mDevices[i].stats : nullptr;
+    }
+
+    /** Clear the counters of all devices. The history is kept. */
+    void resetStats() {
+      for (uint8_t i = 0; i < mNumDevices; ++i) {
+        mDevices[i].stats = RateStats();
+      }
+    }
+
+    /** Total number of speed changes, including those no longer in history. */
+    uint32_t numChanges() const { return mNumChanges; }
+
+    /** Number of entries available through history(). */
+    uint8_t historySize() const {
+      return (mNumChanges < T_HISTORY_SIZE)
+          ? (uint8_t) mNumChanges : T_HISTORY_SIZE;
+    }
+
+    /**
+     * Return the speed change at `index` of the history, from 0 (the oldest
+     * retained) to `historySize() - 1` (the most recent).
+     */
+    const RateChange& history(uint8_t index) const {
+      uint8_t start = (mNumChanges < T_HISTORY_SIZE) ? 0 : mHistoryNext;
+      uint8_t i = start + index;
+      if (i >= T_HISTORY_SIZE) i -= T_HISTORY_SIZE;
+      return mHistory[i];
+    }
+
+    // Delete the copy constructor and assignment operator because this
+    // object holds the state of the devices shared by all copies of the
+    // interface objects.
+    RateController(const RateController&) = delete;
+    RateController& operator=(const RateController&) = delete;
+
+  private:
+    /** The adaptive state of a single device. */
+    struct Device {
+      uint32_t cleanRun = 0;
+      uint16_t windowCount = 0;
+      uint8_t windowErrors = 0;
+      uint8_t step = 0;
+      uint8_t backoffShift = 0;
+      bool probing = false;
+      RateStats stats = RateStats();
+    };
+
+    /** Return the index of the device at `addr`, or mNumDevices. */
+    uint8_t findDevice(uint8_t addr) const {
+      for (uint8_t i = 0; i < mNumDevices; ++i) {
+        if (mProfiles[i].addr == addr) return i;
+      }
+      return mNumDevices;
+    }
+
+    /** Move the device at index `i` to `step`, and record the change. */
+    void changeStep(uint8_t i, uint8_t step) {
+      Device& device = mDevices[i];
+      device.step = step;
+      device.cleanRun = 0;
+      device.windowCount = 0;
+      device.windowErrors = 0;
+      ProfileTraits<T_PROFILE>::set(mProfiles[i], mSteps[step]);
+
+      RateChange& change = mHistory[mHistoryNext];
+      change.millis = millis();
+      change.addr = mProfiles[i].addr;
+      change.step = step;
+      mHistoryNext = (mHistoryNext + 1 >= T_HISTORY_SIZE)
+          ? 0 : mHistoryNext + 1;
+      mNumChanges++;
+    }
+
+  private:
+    T_PROFILE* const mProfiles;
+    uint8_t const mNumDevices;
+    const Value* const mSteps;
+    uint8_t const mNumSteps;
+    uint16_t const mCleanWindow;
+    uint8_t const mErrorThreshold;
+    uint16_t const mErrorWindow;
+    bool const mCountAddressNacks;
+
+    Device mDevices[T_MAX_DEVICES];
+    RateChange mHistory[T_HISTORY_SIZE];
+    uint8_t mHistoryNext = 0;
+    uint32_t mNumChanges = 0;
+};
+
+}
+
+#endif
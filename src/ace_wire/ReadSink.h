@@ -0,0 +1,132 @@
+/*
+MIT License
+
+Copyright (c) 2022 Brian T. Park
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+
+#ifndef ACE_WIRE_READ_SINK_H
+#define ACE_WIRE_READ_SINK_H
+
+#include <stdint.h>
+#include "WireTraits.h"
+
+namespace ace_wire {
+
+/**
+ * Read up to `quantity` bytes from the device at `addr`, passing each byte to
+ * the `sink` functor as it is received. The sink has the signature
+ * `bool(uint8_t data)`, and returns false to end the transfer early. This is
+ * the implementation of the readInto() method of the interface classes which
+ * have no native support for it, using requestFrom() and read() in pieces of
+ * at most WireTraits<T_WIREI>::kMaxQuantity bytes joined by repeated START
+ * conditions.
+ *
+ * Since each piece is requested in advance, the bytes remaining in the piece
+ * after the sink has returned false are still received (and discarded). That
+ * piece was requested without a STOP condition, so the bus is then released
+ * by endRead(), whose cost depends on the interface.
+ *
+ * @param wireInterface the AceWire interface
+ * @param addr I2C address of the device
+ * @param quantity maximum number of bytes to read, or 0 to read until the
+ *    sink returns false
+ * @param sink functor which receives each byte
+ * @param sendStop whether to send the STOP condition at the end
+ *
+ * @return the number of bytes passed to the sink, 0 if the device did not
+ *    respond
+ */
+template <typename T_WIREI, typename F>
+uint32_t streamRead(
+    const T_WIREI& wireInterface, uint8_t addr, uint16_t quantity, F&& sink,
+    bool sendStop = true) {
+  const uint16_t maxRead = WireTraits<T_WIREI>::kMaxQuantity;
+  bool unlimited = (quantity == 0);
+  uint32_t count = 0;
+
+  for (;;) {
+    uint16_t n = (! unlimited && quantity < maxRead) ? quantity : maxRead;
+    if (! unlimited) quantity -= n;
+    bool stop = (! unlimited && quantity == 0) ? sendStop : false;
+    if (wireInterface.requestFrom(addr, n, stop) == 0) {
+      if (! stop) endRead(wireInterface, addr);
+      return count;
+    }
+
+    bool more = true;
+    for (uint16_t i = 0; i < n; ++i) {
+      uint8_t data = wireInterface.read();
+      if (more) {
+        count++;
+        more = sink(data);
+      }
+    }
+    if (! unlimited && quantity == 0) return count;
+    if (! more) {
+      if (sendStop) endRead(wireInterface, addr);
+      return count;
+    }
+  }
+}
+
+/**
+ * A sink for readInto() which collects the bytes into records of `T_SIZE`
+ * bytes, and passes each complete record to the `onRecord` functor with the
+ * signature `bool(const uint8_t* record)`, e.g. one sample of an IMU FIFO.
+ * The functor returns false to end the transfer early. Only a single record
+ * is buffered. Use makeRecordSink() to deduce the type of a lambda.
+ *
+ * @tparam T_SIZE number of bytes of a record
+ * @tparam F type of the functor
+ */
+template <uint8_t T_SIZE, typename F>
+class RecordSink {
+  public:
+    /** Constructor. */
+    explicit RecordSink(const F& onRecord) : mOnRecord(onRecord) {}
+
+    /** Add the byte to the current record. */
+    bool operator()(uint8_t data) {
+      mRecord[mLen++] = data;
+      if (mLen < T_SIZE) return true;
+      mLen = 0;
+      return mOnRecord((const uint8_t*) mRecord);
+    }
+
+    /** Number of bytes of an incomplete record at the end of the transfer. */
+    uint8_t pending() const { return mLen; }
+
+  private:
+    F mOnRecord;
+    uint8_t mLen = 0;
+    uint8_t mRecord[T_SIZE];
+};
+
+/** Create a RecordSink of records of `T_SIZE` bytes. */
+template <uint8_t T_SIZE, typename F>
+RecordSink<T_SIZE, F> makeRecordSink(const F& onRecord) {
+  return RecordSink<T_SIZE, F>(onRecord);
+}
+
+}
+
+#endif
@@ -0,0 +1,195 @@
+/*
+MIT License
+
+Copyright (c) 2022 Brian T. Park
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+
+#ifndef ACE_WIRE_RECORDING_WIRE_INTERFACE_H
+#define ACE_WIRE_RECORDING_WIRE_INTERFACE_H
+
+#include <stdint.h>
+#include "WireTraits.h"
+#include "WireLog.h"
+#include "Message.h"
+
+namespace ace_wire {
+
+/**
+ * A wrapper around any AceWire interface (`T_WIREI`) which forwards every call
+ * to it, and appends the call, its result and its time to a WireLog. This
+ * shows exactly which transactions a driver issues, and how many bytes they
+ * transfer (see WireLog::summarize()). The log can later be served back by
+ * ReplayWireInterface on a host without the hardware.
+ *
+ * The capabilities of `T_WIREI` are passed through unchanged, and transfer()
+ * and readInto() call the native versions of `T_WIREI`, so the driver issues
+ * the same bus operations as it does without the recorder. Recording a single
+ * call or byte takes a few microseconds, which is included in the time of the
+ * next record. In readInto(), that time is spent inside the transfer.
+ *
+ * @tparam T_WIREI the AceWire interface class, e.g. TwoWireInterface
+ */
+template <typename T_WIREI>
+class RecordingWireInterface {
+  public:
+    /** Same as `T_WIREI`. */
+    static const bool kSupportsRepeatedStart =
+        WireTraits<T_WIREI>::kSupportsRepeatedStart;
+
+    /** Same as `T_WIREI`. */
+    static const bool kBuffered = WireTraits<T_WIREI>::kBuffered;
+
+    /** Same as `T_WIREI`. */
+    static const uint16_t kBufferSize = WireTraits<T_WIREI>::kBufferSize;
+
+    /** Same as `T_WIREI`. */
+    static const uint16_t kMaxQuantity = WireTraits<T_WIREI>::kMaxQuantity;
+
+    /** Same as `T_WIREI`. */
+    static const bool kReportsAddressNack =
+        WireTraits<T_WIREI>::kReportsAddressNack;
+
+    /**
+     * Constructor.
+     *
+     * @param wireInterface instance of the AceWire interface
+     * @param log the log which receives the records
+     */
+    explicit RecordingWireInterface(
+        const T_WIREI& wireInterface, WireLog& log) :
+        mWireInterface(wireInterface),
+        mLog(log)
+    {}
+
+    /** Call begin() of the wrapped interface. Not recorded. */
+    void begin() const { mWireInterface.begin(); }
+
+    /** Call end() of the wrapped interface. Not recorded. */
+    void end() const { mWireInterface.end(); }
+
+    /** Forward and record beginTransmission(). */
+    uint8_t beginTransmission(uint8_t addr) const {
+      uint8_t result = mWireInterface.beginTransmission(addr);
+      record(WireLog::kOpBeginTransmission, addr, 0, false, result, 0);
+      return result;
+    }
+
+    /** Forward and record write(). */
+    uint8_t write(uint8_t data) const {
+      uint8_t result = mWireInterface.write(data);
+      record(WireLog::kOpWrite, 0, data, false, result, 0);
+      return result;
+    }
+
+    /** Forward and record endTransmission(). */
+    uint8_t endTransmission(bool sendStop = true) const {
+      uint8_t result = mWireInterface.endTransmission(sendStop);
+      record(WireLog::kOpEndTransmission, 0, 0, sendStop, result, 0);
+      return result;
+    }
+
+    /** Forward and record requestFrom(). */
+    uint16_t requestFrom(
+        uint8_t addr, uint16_t quantity, bool sendStop = true) const {
+      uint16_t received = mWireInterface.requestFrom(addr, quantity, sendStop);
+      record(WireLog::kOpRequestFrom, addr, 0, sendStop,
+          received ? 1 : 0, quantity, received);
+      return received;
+    }
+
+    /** Forward and record read(). */
+    uint8_t read() const {
+      uint8_t data = mWireInterface.read();
+      record(WireLog::kOpRead, 0, data, false, 0, 0);
+      return data;
+    }
+
+    /**
+     * Forward transfer() to the native implementation of `T_WIREI`, and
+     * record its result, followed by the bytes of the messages which
+     * completed.
+     */
+    TransferResult transfer(const Message* msgs, uint8_t count) const {
+      TransferResult result = mWireInterface.transfer(msgs, count);
+      record(WireLog::kOpTransfer, count ? msgs[0].addr : 0, result.index,
+          false, result.status, count);
+      for (uint8_t i = 0; i < result.index && i < count; ++i) {
+        bool isRead = (msgs[i].flags & Message::kRead) != 0;
+        for (uint16_t j = 0; j < msgs[i].len; ++j) {
+          record(isRead ? WireLog::kOpRead : WireLog::kOpWrite, 0,
+              msgs[i].buf[j], false, isRead ? 0 : 1, 0);
+        }
+      }
+      return result;
+    }
+
+    /**
+     * Forward readInto() to the native implementation of `T_WIREI`, and
+     * record the call, followed by each byte passed to the `sink`.
+     */
+    template <typename F>
+    uint32_t readInto(
+        uint8_t addr, uint16_t quantity, F&& sink, bool sendStop = true)
+        const {
+      // The result is set after the transfer, when it is known.
+      uint32_t pos = mLog.size();
+      bool recorded = record(
+          WireLog::kOpReadInto, addr, 0, sendStop, 0, quantity);
+      uint32_t n = mWireInterface.readInto(
+          addr, quantity,
+          [&](uint8_t data) {
+            record(WireLog::kOpRead, 0, data, false, 0, 0);
+            return sink(data);
+          },
+          sendStop);
+      if (recorded && n != 0) mLog.setResult(pos, 1);
+      return n;
+    }
+
+    // Use default copy constructor. Delete the assignment operator because it
+    // cannot work with the reference to the log.
+    RecordingWireInterface(const RecordingWireInterface&) = default;
+    RecordingWireInterface& operator=(const RecordingWireInterface&) = delete;
+
+  private:
+    bool record(
+        uint8_t op, uint8_t addr, uint8_t data, bool sendStop,
+        uint8_t result, uint16_t quantity, uint16_t received = 0) const {
+      WireLogRecord r;
+      r.op = op;
+      r.addr = addr;
+      r.data = data;
+      r.sendStop = sendStop;
+      r.result = result;
+      r.quantity = quantity;
+      r.received = received;
+      return mLog.append(r);
+    }
+
+  private:
+    T_WIREI mWireInterface; // copied by value
+    WireLog& mLog;
+};
+
+}
+
+#endif
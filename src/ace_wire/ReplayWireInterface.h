@@ -0,0 +1,246 @@
+/*
+MIT License
+
+Copyright (c) 2022 Brian T. Park
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+
+#ifndef ACE_WIRE_REPLAY_WIRE_INTERFACE_H
+#define ACE_WIRE_REPLAY_WIRE_INTERFACE_H
+
+#include <stdint.h>
+#include "WireLog.h"
+#include "Message.h"
+
+namespace ace_wire {
+
+/**
+ * An AceWire interface without any hardware, which serves the results and the
+ * read data of a WireLog recorded by RecordingWireInterface. Running a driver
+ * against a trace captured in production (e.g. on Linux under EpoxyDuino)
+ * gives deterministic results, so the effect of a change to the driver can
+ * be measured without the hardware, typically by wrapping this interface in
+ * another RecordingWireInterface and comparing the summaries of the 2 logs.
+ *
+ * The replay is lenient, so that a driver which issues fewer transactions
+ * (e.g. because of a new cache) can still be replayed:
+ *
+ *  * beginTransmission(), requestFrom(), transfer() and readInto() skip
+ *    forward to the next record of the same method and address, and return
+ *    its result. If there is none, the call is answered with a NACK.
+ *  * write(), endTransmission() and read() consume the next record if it is
+ *    of the same method. Otherwise they succeed (read() returns 0xFF) without
+ *    consuming it.
+ *  * transfer() replays the data of its completed messages like write() and
+ *    read(), and readInto() passes the recorded bytes which follow it to the
+ *    sink, until the sink returns false or `quantity` is reached.
+ *
+ * Each call which did not match the log is counted in WireLog::mismatches(),
+ * and the records passed over are counted in WireLog::skipped().
+ *
+ * The capabilities of the interface which recorded the log are not stored in
+ * it. This class declares those of an unbuffered interface with repeated
+ * START.
+ */
+class ReplayWireInterface {
+  public:
+    /** Repeated START is supported. */
+    static const bool kSupportsRepeatedStart = true;
+
+    /** Data is not buffered. */
+    static const bool kBuffered = false;
+
+    /** No buffer, so the size of a transaction is not limited. */
+    static const uint16_t kBufferSize = 0;
+
+    /** Maximum quantity of requestFrom(). */
+    static const uint16_t kMaxQuantity = 65535;
+
+    /** The beginTransmission() method returns the recorded address NACK. */
+    static const bool kReportsAddressNack = true;
+
+    /**
+     * Constructor.
+     * @param log the recorded log, shared by all copies of this interface
+     */
+    explicit ReplayWireInterface(WireLog& log) : mLog(log) {}
+
+    /** Rewind the log to its first record. */
+    void begin() const { mLog.rewind(); }
+
+    /** Does nothing. */
+    void end() const {}
+
+    /**
+     * Replay the next beginTransmission() to `addr`.
+     * @return the recorded result, or 1 (NACK) if there is none
+     */
+    uint8_t beginTransmission(uint8_t addr) const {
+      WireLogRecord record;
+      if (! seek(WireLog::kOpBeginTransmission, addr, record)) return 1;
+      return record.result;
+    }
+
+    /**
+     * Replay the next write().
+     * @return the recorded result, or 1 if the next record is not a write
+     */
+    uint8_t write(uint8_t /*data*/) const {
+      WireLogRecord record;
+      if (! next(WireLog::kOpWrite, record)) return 1;
+      return record.result;
+    }
+
+    /**
+     * Replay the next endTransmission().
+     * @return the recorded status, or 0 if the next record is not an
+     *    endTransmission()
+     */
+    uint8_t endTransmission(bool /*sendStop*/ = true) const {
+      WireLogRecord record;
+      if (! next(WireLog::kOpEndTransmission, record)) return 0;
+      return record.result;
+    }
+
+    /**
+     * Replay the next requestFrom() from `addr`.
+     * @return the recorded number of bytes received, limited to `quantity`,
+     *    or 0 if there is no such record
+     */
+    uint16_t requestFrom(
+        uint8_t addr, uint16_t quantity, bool /*sendStop*/ = true) const {
+      WireLogRecord record;
+      if (! seek(WireLog::kOpRequestFrom, addr, record)) return 0;
+      return (quantity < record.received) ? quantity : record.received;
+    }
+
+    /**
+     * Replay the next read().
+     * @return the recorded data byte, or 0xFF if the next record is not a
+     *    read
+     */
+    uint8_t read() const {
+      WireLogRecord record;
+      if (! next(WireLog::kOpRead, record)) return 0xFF;
+      return record.data;
+    }
+
+    /**
+     * Replay the next transfer() whose first message is to the address of
+     * `msgs[0]`, filling the read messages which completed.
+     * @return the recorded result, or status 2 at index 0 if there is none
+     */
+    TransferResult transfer(const Message* msgs, uint8_t count) const {
+      WireLogRecord record;
+      uint8_t addr = count ? msgs[0].addr : 0;
+      if (! seek(WireLog::kOpTransfer, addr, record)) {
+        return TransferResult{2, 0};
+      }
+      for (uint8_t i = 0; i < record.data && i < count; ++i) {
+        bool isRead = (msgs[i].flags & Message::kRead) != 0;
+        for (uint16_t j = 0; j < msgs[i].len; ++j) {
+          if (isRead) {
+            msgs[i].buf[j] = read();
+          } else {
+            write(msgs[i].buf[j]);
+          }
+        }
+      }
+      return TransferResult{record.result, record.data};
+    }
+
+    /**
+     * Replay the next readInto() from `addr`, passing the recorded bytes to
+     * the `sink` functor until it returns false or `quantity` (0 for no limit)
+     * is reached.
+     * @return the number of bytes passed to the sink, 0 if the device did not
+     *    respond or there is no such record
+     */
+    template <typename F>
+    uint32_t readInto(
+        uint8_t addr, uint16_t quantity, F&& sink, bool /*sendStop*/ = true)
+        const {
+      WireLogRecord record;
+      if (! seek(WireLog::kOpReadInto, addr, record)) return 0;
+      if (record.result == 0) return 0;
+
+      uint32_t count = 0;
+      while (quantity == 0 || count < quantity) {
+        if (! consume(WireLog::kOpRead, record)) break;
+        count++;
+        if (! sink(record.data)) break;
+      }
+      return count;
+    }
+
+    // Use default copy constructor. Delete the assignment operator because it
+    // cannot work with the reference to the log.
+    ReplayWireInterface(const ReplayWireInterface&) = default;
+    ReplayWireInterface& operator=(const ReplayWireInterface&) = delete;
+
+  private:
+    /**
+     * Consume the next record if it is of method `op`. Otherwise count a
+     * mismatch.
+     */
+    bool next(uint8_t op, WireLogRecord& record) const {
+      if (consume(op, record)) return true;
+      mLog.addMismatch();
+      return false;
+    }
+
+    /** Consume the next record if it is of method `op`. */
+    bool consume(uint8_t op, WireLogRecord& record) const {
+      uint32_t pos = mLog.replayPosition();
+      if (mLog.decode(pos, record) && record.op == op) {
+        mLog.setReplayPosition(pos);
+        return true;
+      }
+      return false;
+    }
+
+    /**
+     * Consume the records up to and including the next one of method `op`
+     * and address `addr`. If there is none, count a mismatch and consume
+     * nothing.
+     */
+    bool seek(uint8_t op, uint8_t addr, WireLogRecord& record) const {
+      uint32_t pos = mLog.replayPosition();
+      uint16_t skipped = 0;
+      while (mLog.decode(pos, record)) {
+        if (record.op == op && record.addr == addr) {
+          mLog.setReplayPosition(pos);
+          mLog.addSkipped(skipped);
+          return true;
+        }
+        skipped++;
+      }
+      mLog.addMismatch();
+      return false;
+    }
+
+  private:
+    WireLog& mLog;
+};
+
+}
+
+#endif
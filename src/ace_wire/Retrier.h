@@ -0,0 +1,268 @@
+/*
+MIT License
+
+Copyright (c) 2022 Brian T. Park
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+
+#ifndef ACE_WIRE_RETRIER_H
+#define ACE_WIRE_RETRIER_H
+
+#include <stdint.h>
+#include <Arduino.h> // micros(), yield()
+
+namespace ace_wire {
+
+/** Retry statistics of a Retrier. */
+struct RetryStats {
+  /** Number of statuses tracked in `failures`, i.e. the codes 0-7. */
+  static const uint8_t kNumStatusCodes = 8;
+
+  /** Number of times the transaction was executed. */
+  uint16_t attempts;
+
+  /** Number of transactions which succeeded, including after retries. */
+  uint16_t successes;
+
+  /** Number of transactions which failed after their last attempt. */
+  uint16_t giveUps;
+
+  /**
+   * Number of failed attempts for each status code (e.g. `failures[2]` is the
+   * number of address NACKs). Codes of 8 or above are counted in
+   * `failures[0]`, which is otherwise unused.
+   */
+  uint16_t failures[kNumStatusCodes];
+
+  /** Total time spent in the backoff between attempts, in microseconds. */
+  uint32_t backoffMicros;
+};
+
+/**
+ * Re-run a whole transaction on any AceWire interface (`T_WIREI`) when it
+ * fails with a transient error, e.g. the address NACK of an EEPROM in its
+ * write cycle, or of a sensor in the middle of a conversion. Each attempt
+ * calls the `transaction` functor (usually a lambda) with the interface, and
+ * the functor returns the status codes of endTransmission(), or the codes of
+ * the helper classes:
+ *
+ *  * 0: success
+ *  * 1: length too long for buffer
+ *  * 2: address send, NACK received
+ *  * 3: data send, NACK received
+ *  * 4: other twi error (lost bus arbitration, bus error, ..)
+ *  * 5: timeout
+ *  * 6: PEC error
+ *
+ * Only the statuses in the `retryMask` (by default 2, 3 and 5) are retried, up
+ * to `maxAttempts` attempts in total. The backoff before each retry is either
+ * constant, linear or exponential in the number of failed attempts, capped at
+ * `maxBackoffMicros`. Every failed attempt is counted by its status in
+ * stats(), to find the devices and the causes which cost the most time.
+ *
+ * The run() method waits for the backoff, calling yield(). The tryRun()
+ * method never waits, so it can be used by a coroutine of a cooperative
+ * scheduler:
+ *
+ * @code
+ * COROUTINE_AWAIT((status = retrier.tryRun(readSensor)) != kStatusPending);
+ * @endcode
+ *
+ * The state of a pending tryRun() is kept in the Retrier, so each concurrent
+ * transaction needs its own instance.
+ *
+ * @tparam T_WIREI the AceWire interface class, e.g. TwoWireInterface
+ */
+template <typename T_WIREI>
+class Retrier {
+  public:
+    /** Status returned by tryRun() while a retry is waiting for its backoff. */
+    static const uint8_t kStatusPending = 0xFF;
+
+    /** The backoff is always `backoffMicros`. */
+    static const uint8_t kConstant = 0;
+
+    /** The backoff is `backoffMicros` times the number of failed attempts. */
+    static const uint8_t kLinear = 1;
+
+    /** The backoff doubles after each failed attempt. */
+    static const uint8_t kExponential = 2;
+
+    /** Bit of status `code` in the `retryMask` of the constructor. */
+    static constexpr uint8_t retryBit(uint8_t code) {
+      return (uint8_t) (1 << code);
+    }
+
+    /** Default `retryMask`: address NACK, data NACK and timeout. */
+    static const uint8_t kRetryDefault = (1 << 2) | (1 << 3) | (1 << 5);
+
+    /**
+     * Constructor.
+     *
+     * @param wireInterface instance of the AceWire interface
+     * @param maxAttempts total number of attempts, including the first one
+     *    (default 3)
+     * @param backoffMicros backoff before the first retry (default 1000)
+     * @param backoffMode kConstant, kLinear or kExponential (default
+     *    kExponential)
+     * @param maxBackoffMicros upper limit of the backoff (default 20000)
+     * @param retryMask bit mask of the statuses which are retried, see
+     *    retryBit() (default kRetryDefault)
+     */
+    explicit Retrier(
+        const T_WIREI& wireInterface,
+        uint8_t maxAttempts = 3,
+        uint32_t backoffMicros = 1000,
+        uint8_t backoffMode = kExponential,
+        uint32_t maxBackoffMicros = 20000,
+        uint8_t retryMask = kRetryDefault
+    ) :
+        mWireInterface(wireInterface),
+        mMaxAttempts(maxAttempts ? maxAttempts : 1),
+        mBackoffMicros(backoffMicros),
+        mBackoffMode(backoffMode),
+        mMaxBackoffMicros(maxBackoffMicros),
+        mRetryMask(retryMask)
+    {
+      resetStats();
+    }
+
+    /**
+     * Execute the `transaction` until it succeeds, fails with a status which
+     * is not retried, or `maxAttempts` is reached. Waits for the backoff
+     * between attempts, calling yield().
+     *
+     * @param transaction functor with the signature
+     *    `uint8_t(const T_WIREI&)` which returns the status of the
+     *    transaction
+     * @return the status of the last attempt
+     */
+    template <typename F>
+    uint8_t run(F transaction) {
+      uint8_t status;
+      while ((status = tryRun(transaction)) == kStatusPending) {
+        yield();
+      }
+      return status;
+    }
+
+    /**
+     * Execute the next attempt of the `transaction` if its backoff has
+     * elapsed, without waiting.
+     *
+     * @return kStatusPending if the attempt failed and will be retried, or if
+     *    the backoff of the previous attempt has not elapsed yet, otherwise
+     *    the final status of the transaction
+     */
+    template <typename F>
+    uint8_t tryRun(F transaction) {
+      if (mAttempt && (uint32_t) (micros() - mFailMicros) < mWaitMicros) {
+        return kStatusPending;
+      }
+      if (mAttempt) mStats.backoffMicros += micros() - mFailMicros;
+
+      mStats.attempts++;
+      uint8_t status = transaction(mWireInterface);
+      // A transaction must not look like it is pending.
+      if (status == kStatusPending) status = 4;
+      if (status == 0) {
+        mStats.successes++;
+        mAttempt = 0;
+        return 0;
+      }
+
+      mStats.failures[status < RetryStats::kNumStatusCodes ? status : 0]++;
+      mAttempt++;
+      if (! isRetried(status) || mAttempt >= mMaxAttempts) {
+        mStats.giveUps++;
+        mAttempt = 0;
+        return status;
+      }
+
+      mWaitMicros = backoff(mAttempt);
+      mFailMicros = micros();
+      return kStatusPending;
+    }
+
+    /**
+     * Abandon the retries of a pending tryRun(), so that the next call starts
+     * a new transaction. Not counted as a give up.
+     */
+    void cancel() { mAttempt = 0; }
+
+    /** Return true if a tryRun() is waiting to be retried. */
+    bool isPending() const { return mAttempt != 0; }
+
+    /** Return the statistics. */
+    const RetryStats& stats() const { return mStats; }
+
+    /** Clear the statistics. */
+    void resetStats() {
+      mStats.attempts = 0;
+      mStats.successes = 0;
+      mStats.giveUps = 0;
+      for (uint8_t i = 0; i < RetryStats::kNumStatusCodes; ++i) {
+        mStats.failures[i] = 0;
+      }
+      mStats.backoffMicros = 0;
+    }
+
+    // Use default copy constructor. Delete the assignment operator because it
+    // cannot work with constant fields.
+    Retrier(const Retrier&) = default;
+    Retrier& operator=(const Retrier&) = delete;
+
+  private:
+    /** Return true if the `status` is in the retry mask. */
+    bool isRetried(uint8_t status) const {
+      return status < 8 && (mRetryMask & retryBit(status));
+    }
+
+    /** Backoff after `failed` failed attempts. */
+    uint32_t backoff(uint8_t failed) const {
+      uint32_t wait = mBackoffMicros;
+      if (mBackoffMode == kLinear) {
+        wait *= failed;
+      } else if (mBackoffMode == kExponential) {
+        for (uint8_t i = 1; i < failed && wait < mMaxBackoffMicros; ++i) {
+          wait <<= 1;
+        }
+      }
+      return (wait < mMaxBackoffMicros) ? wait : mMaxBackoffMicros;
+    }
+
+  private:
+    T_WIREI mWireInterface; // copied by value
+    uint8_t const mMaxAttempts;
+    uint32_t const mBackoffMicros;
+    uint8_t const mBackoffMode;
+    uint32_t const mMaxBackoffMicros;
+    uint8_t const mRetryMask;
+
+    uint8_t mAttempt = 0;
+    uint32_t mFailMicros = 0;
+    uint32_t mWaitMicros = 0;
+    RetryStats mStats;
+};
+
+}
+
+#endif
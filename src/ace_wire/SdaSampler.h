@@ -0,0 +1,112 @@
+/*
+MIT License
+
+Copyright (c) 2022 Brian T. Park
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef ACE_WIRE_SDA_SAMPLER_H
+#define ACE_WIRE_SDA_SAMPLER_H
+
+#include <stdint.h>
+
+namespace ace_wire {
+
+/**
+ * Policies for sampling the SDA line while SCL is HIGH, used by the read()
+ * and readAck() methods of SimpleWireInterface and SimpleWireFastInterface.
+ * At aggressive bit delays, a single sample taken right after the rising edge
+ * of SCL can pick up the ringing or the slow rise of SDA on a long cable. The
+ * other policies trade a little time per bit for immunity to those effects,
+ * which is usually much cheaper than increasing the delay of every
+ * transition.
+ *
+ *  * kOnce: a single sample right after SCL goes HIGH (default)
+ *  * kMajority: the majority of 3 samples spaced by half a bit delay, which
+ *    suppresses the spikes and ringing shorter than the spacing (the I2C spec
+ *    requires 50 ns of spike suppression in the receiver). The samples span
+ *    one extra bit delay into the HIGH period of SCL. At bit delays below
+ *    2 micros, the spacing is 0, and the samples are only separated by the
+ *    time taken to read the pin.
+ *  * kDelayed: wait another bit delay into the HIGH period of SCL before
+ *    sampling once, so that SDA has settled
+ *  * kStable: sample until 2 consecutive samples agree, up to
+ *    kMaxStableSamples
+ */
+class SdaSampler {
+  public:
+    /** Sample once. */
+    static const uint8_t kOnce = 0;
+
+    /** Take the majority of 3 samples spaced by half a bit delay. */
+    static const uint8_t kMajority = 1;
+
+    /** Sample once, after an additional bit delay. */
+    static const uint8_t kDelayed = 2;
+
+    /** Sample until 2 consecutive samples agree. */
+    static const uint8_t kStable = 3;
+
+    /** Maximum number of samples taken by kStable. */
+    static const uint8_t kMaxStableSamples = 8;
+
+    /**
+     * Sample the SDA line using the given policy.
+     *
+     * @param policy one of kOnce, kMajority, kDelayed, kStable
+     * @param readData function object which returns the SDA level (0 or 1)
+     * @param bitDelay function object which waits for one bit delay
+     * @param halfBitDelay function object which waits for half a bit delay,
+     *    the spacing of the samples of kMajority
+     */
+    template <typename T_READ, typename T_DELAY, typename T_HALF_DELAY>
+    static uint8_t sample(
+        uint8_t policy, T_READ readData, T_DELAY bitDelay,
+        T_HALF_DELAY halfBitDelay) {
+      switch (policy) {
+        case kMajority: {
+          uint8_t a = readData();
+          halfBitDelay();
+          uint8_t b = readData();
+          halfBitDelay();
+          uint8_t c = readData();
+          return (a & b) | (a & c) | (b & c);
+        }
+        case kDelayed:
+          bitDelay();
+          return readData();
+        case kStable: {
+          uint8_t prev = readData();
+          for (uint8_t i = 1; i < kMaxStableSamples; ++i) {
+            uint8_t bit = readData();
+            if (bit == prev) break;
+            prev = bit;
+          }
+          return prev;
+        }
+        default:
+          return readData();
+      }
+    }
+};
+
+}
+
+#endif
@@ -26,6 +26,7 @@ SOFTWARE.
 #define ACE_WIRE_SEEED_WIRE_INTERFACE_H
 
 #include <stdint.h>
+#include "GenericTransfer.h"
 
 namespace ace_wire {
 
@@ -35,11 +36,36 @@ namespace ace_wire {
  * becomes compatible with the AceWire API. The Arduino_Software_I2C library
  * uses no RX or TX buffer.
  *
+ * Since repeated START is not supported, the transfer() of GenericTransfer
+ * sends a STOP condition after every message instead, so a register read
+ * relies on the device keeping its register pointer across the STOP. The
+ * readInto() method sends a STOP after every piece of kMaxQuantity bytes.
+ *
  * @tparam T_WIRE underlying class which will be SoftwareI2C
  */
 template <typename T_WIRE>
-class SeeedWireInterface {
+class SeeedWireInterface :
+    public GenericTransfer<SeeedWireInterface<T_WIRE>> {
   public:
+    /**
+     * The `sendStop` parameter cannot be honored. The start condition of
+     * SoftwareI2C assumes that both lines are already HIGH, and its only
+     * public primitive which releases SCL is the STOP condition.
+     */
+    static const bool kSupportsRepeatedStart = false;
+
+    /** Data is sent to the bus immediately by write(). */
+    static const bool kBuffered = false;
+
+    /** No buffer, so the size of a transaction is not limited. */
+    static const uint16_t kBufferSize = 0;
+
+    /** Maximum quantity of requestFrom(), limited by its 8-bit type. */
+    static const uint16_t kMaxQuantity = 255;
+
+    /** The beginTransmission() method reports the NACK of the address. */
+    static const bool kReportsAddressNack = true;
+
     /**
      * Constructor.
      * @param wire instance of `SoftwareI2C`
@@ -99,19 +125,21 @@ class SeeedWireInterface {
      * not implement at TX buffer, so the addr is sent immediately on the bus.
      *
      * @param addr I2C address
-     * @param quantity number of bytes to read
+     * @param quantity number of bytes to read, at most 255
      * @param sendStop whether to send a STOP condition after reading. This
      *    parameter is ignored by the SoftwareI2C class which always sends a
      *    STOP condition.
      *
-     * @return the value returned by the underlying SoftwareI2C::requestFrom()
-     * method, which is 0 for success if the device responded with an ACK, and 1
-     * if the device sent a NACK
+     * @return `quantity` if the device responded with an ACK, 0 if the device
+     * sent a NACK. The underlying SoftwareI2C::requestFrom() method returns
+     * 1 upon ACK and 0 upon NACK, like its beginTransmission().
      */
-    uint8_t requestFrom(uint8_t addr, uint8_t quantity, bool sendStop = true)
-        const {
+    uint16_t requestFrom(
+        uint8_t addr, uint16_t quantity, bool sendStop = true) const {
+      // The underlying library supports only an 8-bit quantity.
+      if (quantity > 255) return 0;
       (void) sendStop;
-      return mWire.requestFrom(addr, quantity);
+      return mWire.requestFrom(addr, (uint8_t) quantity) ? quantity : 0;
     }
 
     /**
@@ -27,9 +27,48 @@ SOFTWARE.
 
 #include <stdint.h>
 #include <Arduino.h> // delayMicroseconds()
+#include "SpeedProfile.h"
+#include "SdaSampler.h"
+#include "Message.h"
+#include "ReadSink.h"
 
 namespace ace_wire {
 
+/**
+ * The default compile-time options of SimpleWireFastInterface, which disable
+ * all optional features. To enable some of them, derive a class and redefine
+ * only the constants which differ from the defaults, for example:
+ *
+ * @code
+ * struct MyOptions : SimpleWireFastOptions {
+ *   static const bool kLatchErrors = true;
+ * };
+ * using WireInterface = SimpleWireFastInterface<2, 3, 5, MyOptions>;
+ * @endcode
+ */
+struct SimpleWireFastOptions {
+  /**
+   * Policy for sampling SDA in read() and readAck(), one of the constants in
+   * SdaSampler.
+   */
+  static const uint8_t kSampling = SdaSampler::kOnce;
+
+  /** Drive SCL in push-pull mode if begin() detects no clock stretching. */
+  static const bool kPushPull = false;
+
+  /**
+   * Detect the loss of arbitration to another master, and wait for the bus
+   * to become free before a START.
+   */
+  static const bool kMultiMaster = false;
+
+  /**
+   * Latch the first NACK of a transaction, skip the following write() calls,
+   * and return the NACK from endTransmission().
+   */
+  static const bool kLatchErrors = false;
+};
+
 /**
  * A version of SimpleWireInterface that uses one of the <digitalWriteFast.h>
  * libraries. The biggest benefit of using digitalWriteFast is the reduction of
@@ -40,17 +79,108 @@ namespace ace_wire {
  * depend on the capacitance and resistance on the DATA and CLOCK lines, and the
  * accuracy of the `delayMicroseconds()` function.
  *
+ * The optional features are selected by the static constants of the
+ * `T_OPTIONS` class (see SimpleWireFastOptions), described below.
+ *
+ * The bit delay can be selected per device using a compile-time profile
+ * `T_PROFILE`, which is a class with a static `delayMicros(uint8_t addr)`
+ * method (see NoDelayProfile). The delay is selected by beginTransmission()
+ * and requestFrom(), and is shared by all copies of the interface object,
+ * since they all drive the same pins. With the default NoDelayProfile, the
+ * delay is the compile-time constant `T_DELAY_MICROS` as before.
+ *
+ * The SDA line is sampled using the SdaSampler policy given by `kSampling`.
+ * Since the policy is a compile-time constant, only the selected policy is
+ * compiled.
+ *
+ * If `kPushPull` is `true`, SCL is actively driven HIGH instead of being
+ * released to the pull-up resistor, which gives sharp rising edges regardless
+ * of the RC time constant of the bus. SDA remains open-drain. This is safe
+ * only if this is the only master on the bus, and no slave stretches the
+ * clock, since a slave holding SCL LOW would be shorted against the output.
+ * So begin() first probes the devices in open-drain mode, and enables the
+ * push-pull mode only if none of them held SCL LOW. Each device is probed in
+ * the read direction, by reading one byte and sending a NACK and a STOP,
+ * since slaves implemented in firmware usually stretch the clock while they
+ * prepare the first byte of a read. Use isPushPull() to verify the outcome.
+ *
+ * The probe has limits. It cannot detect a device which is absent or asleep
+ * during begin(), or which stretches the clock only at other times (e.g.
+ * after a write, or while a conversion is running). Reading a byte can have
+ * side effects on a device whose reads pop a FIFO or clear status flags, so
+ * begin(addrs, numAddrs) probes only the given addresses instead of
+ * 0x08-0x77. A slow rising edge of SCL may be mistaken for clock stretching,
+ * which only leaves SCL in open-drain mode.
+ *
+ * If `kMultiMaster` is `true`, the interface can share the bus with other
+ * masters, like the same option of SimpleWireInterface. A START (except a
+ * repeated START) waits for the bus to be free for the bus free time (tBUF),
+ * releasing SCL waits for the line to actually go HIGH, and SDA is
+ * read back after each HIGH bit sent by write(). Upon the loss of
+ * arbitration, both lines are released and endTransmission() returns
+ * kStatusArbitrationLost. If the bus stays busy, endTransmission() returns
+ * kStatusBusBusy. This mode cannot be combined with `kPushPull`.
+ *
+ * If `kLatchErrors` is `true`, the first NACK of a transaction is latched,
+ * like the same option of SimpleWireInterface. The following write()
+ * calls return 0 without touching the bus, and endTransmission() sends the
+ * STOP condition and returns kStatusAddressNack or kStatusDataNack.
+ *
  * @tparam T_DATA_PIN SDA pin
  * @tparam T_CLOCK_PIN SCL pin
  * @tparam T_DELAY_MICROS delay after each bit transition of SDA or SCL
+ * @tparam T_OPTIONS the compile-time options, SimpleWireFastOptions or a
+ *    class derived from it (default SimpleWireFastOptions)
+ * @tparam T_PROFILE compile-time per-device delay profile (default
+ *    NoDelayProfile which uses T_DELAY_MICROS for all devices)
  */
 template <
     uint8_t T_DATA_PIN,
     uint8_t T_CLOCK_PIN,
-    uint8_t T_DELAY_MICROS
+    uint8_t T_DELAY_MICROS,
+    typename T_OPTIONS = SimpleWireFastOptions,
+    typename T_PROFILE = NoDelayProfile
 >
 class SimpleWireFastInterface {
+  static const uint8_t kSampling = T_OPTIONS::kSampling;
+  static const bool kPushPull = T_OPTIONS::kPushPull;
+  static const bool kMultiMaster = T_OPTIONS::kMultiMaster;
+  static const bool kLatchErrors = T_OPTIONS::kLatchErrors;
+
+  static_assert(! kMultiMaster || ! kPushPull,
+      "kMultiMaster cannot be combined with kPushPull");
+
   public:
+    /**
+     * The `sendStop = false` parameter of endTransmission() and requestFrom()
+     * is honored, so the next transaction begins with a repeated START.
+     */
+    static const bool kSupportsRepeatedStart = true;
+
+    /** Data is sent to the bus immediately by write(). */
+    static const bool kBuffered = false;
+
+    /** No buffer, so the size of a transaction is not limited. */
+    static const uint16_t kBufferSize = 0;
+
+    /** Maximum quantity of requestFrom(). */
+    static const uint16_t kMaxQuantity = 65535;
+
+    /** The beginTransmission() method reports the NACK of the address. */
+    static const bool kReportsAddressNack = true;
+
+    /** Status code of endTransmission() for a latched address NACK. */
+    static const uint8_t kStatusAddressNack = 2;
+
+    /** Status code of endTransmission() for a latched data NACK. */
+    static const uint8_t kStatusDataNack = 3;
+
+    /** Status code of endTransmission() if another master won the bus. */
+    static const uint8_t kStatusArbitrationLost = 4;
+
+    /** Status code of endTransmission() if the bus did not become free. */
+    static const uint8_t kStatusBusBusy = 5;
+
     /** Constructor. */
     explicit SimpleWireFastInterface() = default;
 
@@ -62,38 +192,62 @@ class SimpleWireFastInterface {
      * end of the line pulling LOW. Instead, we go into INPUT mode to let the
      * line to HIGH through the pullup resistor, then go to OUTPUT mode only
      * to pull down.
+     *
+     * If `kPushPull` is true, the clock is then switched to push-pull mode,
+     * unless a device at any of the addresses 0x08-0x77 is detected
+     * stretching the clock.
+     */
+    void begin() const { begin(nullptr, 0); }
+
+    /**
+     * Same as begin(), but if `kPushPull` is true, probe only the `numAddrs`
+     * devices in `addrs` for clock stretching.
      */
-    void begin() const {
+    void begin(const uint8_t* addrs, uint8_t numAddrs) const {
+      if (kPushPull) sPushPull = false;
       digitalWriteFast(T_CLOCK_PIN, LOW);
       digitalWriteFast(T_DATA_PIN, LOW);
 
       // Begin with both lines in INPUT mode to passively go HIGH.
       clockHigh();
       dataHigh();
+
+      if (kPushPull && ! detectClockStretching(addrs, numAddrs)) {
+        digitalWriteFast(T_CLOCK_PIN, HIGH);
+        pinModeFast(T_CLOCK_PIN, OUTPUT);
+        sPushPull = true;
+      }
     }
 
     /** Set clock and data pins to INPUT mode. */
     void end() const {
+      if (kPushPull && sPushPull) {
+        sPushPull = false;
+        pinModeFast(T_CLOCK_PIN, INPUT);
+        digitalWriteFast(T_CLOCK_PIN, LOW);
+      }
       clockHigh();
       dataHigh();
     }
 
+    /** Return true if SCL is being driven in push-pull mode. */
+    static bool isPushPull() { return kPushPull && sPushPull; }
+
     /**
      * Send I2C START condition.
      *
      * @param addr I2C address of slave device
-     * @return 0 if ACK, 1 if NACK
+     * @return 0 if ACK, 1 if NACK, the bus was busy, or the arbitration was
+     *    lost
      */
     uint8_t beginTransmission(uint8_t addr) const {
-      clockHigh();
-      dataHigh();
-
-      dataLow();
-      clockLow();
+      selectDelay(addr);
+      if (! start()) return 1;
 
       // Send I2C addr (7 bits) and the R/W bit set to "write" (0x00).
       uint8_t effectiveAddr = (addr << 1) | 0x00;
       uint8_t res = write(effectiveAddr);
+      if (! res) latchAddressNack();
       return res ^ 0x1;
     }
 
@@ -105,9 +259,12 @@ class SimpleWireFastInterface {
      * does not seem to cause any problems with the LED modules that I have
      * tested.
      *
-     * @return 1 if successful with ACK, 0 for NACK.
+     * @return 1 if successful with ACK, 0 for NACK or the loss of arbitration,
+     *    or if an earlier NACK was latched
      */
     uint8_t write(uint8_t data) const {
+      if ((kMultiMaster || kLatchErrors) && mBusStatus) return 0;
+
       for (uint8_t i = 0;  i < 8; ++i) {
         if (data & 0x80) {
           dataHigh();
@@ -115,6 +272,11 @@ class SimpleWireFastInterface {
           dataLow();
         }
         clockHigh();
+        if (kMultiMaster && (data & 0x80)
+            && digitalReadFast(T_DATA_PIN) == LOW) {
+          loseArbitration();
+          return 0;
+        }
         // An extra bitDelay() here would make the HIGH and LOW states symmetric
         // in duration (if digitalWriteFast() is assumed to be infinitely fast).
         // But actual devices that I have tested seem to support the absence of
@@ -125,48 +287,67 @@ class SimpleWireFastInterface {
       }
 
       uint8_t ack = readAck();
-      return ack ^ 0x1;
+      return latchDataNack(ack ^ 0x1);
     }
 
     /**
-     * Send the I2C STOP condition.
+     * Send the I2C STOP condition. Nothing is sent if the transaction was
+     * abandoned because the bus was busy or the arbitration was lost. A
+     * latched NACK always ends the transaction with the STOP condition,
+     * unless requestFrom() has already sent it.
      *
-     * @return always returns 0 to indicate success
+     * @return 0 upon success, kStatusAddressNack or kStatusDataNack if a NACK
+     *    was latched, kStatusArbitrationLost or kStatusBusBusy
      */
     uint8_t endTransmission(bool sendStop = true) const {
-      // clock will always be LOW when this is called
-      if (sendStop) {
-        dataLow();
-        clockHigh();
-        dataHigh();
+      uint8_t status = 0;
+      if ((kMultiMaster || kLatchErrors) && mBusStatus) {
+        status = mBusStatus;
+        mBusStatus = 0;
+        if (status >= kStatusArbitrationLost) return status;
+        sendStop = mOwnsBus;
       }
 
-      return 0;
+      if (sendStop) stop();
+      return status;
     }
 
     /**
      * Prepare to read bytes by sending I2C START condition. If `sendStop` is
      * true, then a STOP condition will be sent by `read()` after the last byte.
      *
+     * There is no RX buffer, so `quantity` is limited only by its 16-bit
+     * type.
+     *
+     * If the device responds with a NACK, there is nothing for read() to
+     * read, and it returns 0xff without touching the bus. The STOP condition
+     * is sent immediately if `sendStop` is true, even if the NACK was
+     * latched, whose status is still returned by a following
+     * endTransmission().
+     *
      * @return 'quantity' if addr was written successfully and the device
-     * responded with ACK, 0 if device responded with NACK
+     * responded with ACK, 0 if device responded with NACK, the bus was busy,
+     * or the arbitration was lost
      */
-    uint8_t requestFrom(
-        uint8_t addr, uint8_t quantity, bool sendStop = true) const {
-      mQuantity = quantity;
+    uint16_t requestFrom(
+        uint8_t addr, uint16_t quantity, bool sendStop = true) const {
       mSendStop = sendStop;
-
-      clockHigh();
-      dataHigh();
-
-      dataLow();
-      clockLow();
+      selectDelay(addr);
+      mQuantity = 0;
+      if (! start()) return 0;
 
       // Send I2C addr (7 bits) and the R/W bit set to "read" (0x01).
       uint8_t effectiveAddr = (addr << 1) | 0x01;
       uint8_t status = write(effectiveAddr);
+      if (status == 0) {
+        latchAddressNack();
+        bool lost = (kMultiMaster && mBusStatus >= kStatusArbitrationLost);
+        if (sendStop && ! lost) stop();
+        return 0;
+      }
 
-      return (status == 0) ? 0 : quantity;
+      mQuantity = quantity;
+      return quantity;
     }
 
     /**
@@ -186,16 +367,7 @@ class SimpleWireFastInterface {
       // Caller should not call when mQuantity is 0, but let's guard against it.
       if (! mQuantity) return 0xff;
 
-      // Read one byte
-      dataHigh();
-      uint8_t data = 0;
-      for (uint8_t i = 0; i < 8; ++i) {
-        clockHigh();
-        data <<= 1;
-        uint8_t bit = digitalReadFast(T_DATA_PIN);
-        data |= (bit & 0x1);
-        clockLow();
-      }
+      uint8_t data = readBits();
 
       // Decrement quantity to determine if NACK or ACK should be sent.
       mQuantity--;
@@ -209,12 +381,147 @@ class SimpleWireFastInterface {
       return data;
     }
 
+    /**
+     * Execute the array of `count` messages as a single combined transaction,
+     * joined by repeated START conditions, with a STOP condition after the
+     * last message. See transferMessages().
+     */
+    TransferResult transfer(const Message* msgs, uint8_t count) const {
+      return transferMessages(*this, msgs, count);
+    }
+
+    /**
+     * Read up to `quantity` bytes (0 for no limit) from the device at `addr`,
+     * passing each byte to the `sink` functor with the signature
+     * `bool(uint8_t data)` as soon as it is received, without any buffer. The
+     * sink is called before the ACK of the byte is sent, so if it returns
+     * false, the byte is answered with a NACK and the transfer ends
+     * immediately. If the device does not respond, the STOP condition is sent
+     * if `sendStop` is true.
+     *
+     * @return the number of bytes passed to the sink, 0 if the device did not
+     *    respond
+     */
+    template <typename F>
+    uint32_t readInto(
+        uint8_t addr, uint16_t quantity, F&& sink, bool sendStop = true)
+        const {
+      if (requestFrom(addr, 1, false /*sendStop*/) == 0) {
+        endTransmission(sendStop);
+        return 0;
+      }
+      mQuantity = 0;
+
+      uint32_t count = 0;
+      bool more = true;
+      while (more) {
+        uint8_t data = readBits();
+        count++;
+        more = sink(data) && (quantity == 0 || count < quantity);
+        if (more) {
+          sendAck();
+        } else {
+          sendNack();
+        }
+      }
+      endTransmission(sendStop);
+      return count;
+    }
+
     // Use default copy constructor and assignment operator.
     SimpleWireFastInterface(const SimpleWireFastInterface&) = default;
     SimpleWireFastInterface& operator=(const SimpleWireFastInterface&) =
         default;
 
   private:
+    /**
+     * Send the START condition. With kMultiMaster, a START which is not a
+     * repeated START first waits for the bus to become free.
+     *
+     * @return true if the START condition was sent, false if the bus is busy
+     */
+    bool start() const {
+      if (kMultiMaster || kLatchErrors) mBusStatus = 0;
+      if (kMultiMaster && ! mOwnsBus && ! waitForBusFree()) {
+        mBusStatus = kStatusBusBusy;
+        return false;
+      }
+      if (kMultiMaster || kLatchErrors) mOwnsBus = true;
+
+      clockHigh();
+      dataHigh();
+
+      dataLow();
+      clockLow();
+      return true;
+    }
+
+    /** Send the STOP condition. The clock is always LOW when this is called. */
+    void stop() const {
+      dataLow();
+      clockHigh();
+      dataHigh();
+      mOwnsBus = false;
+    }
+
+    /**
+     * Wait until both SDA and SCL have been HIGH continuously for the bus
+     * free time, plus 2 bit delays. Another master in the middle of a
+     * transaction pulls SCL LOW at least once every bit period.
+     *
+     * @return true if the bus is free, false upon timeout
+     */
+    static bool waitForBusFree() {
+      uint16_t freeMicros = kBusFreeMicros + 2 * (
+          IsDelayProfileEnabled<T_PROFILE>::kValue
+              ? sDelayMicros : T_DELAY_MICROS);
+      uint16_t idle = 0;
+      for (uint16_t i = 0; i < kBusBusyTimeoutMicros; ++i) {
+        if (digitalReadFast(T_CLOCK_PIN) == LOW
+            || digitalReadFast(T_DATA_PIN) == LOW) {
+          idle = 0;
+        } else if (++idle >= freeMicros) {
+          return true;
+        }
+        delayMicroseconds(1);
+      }
+      return false;
+    }
+
+    /** Latch the NACK of `res` (0) if kLatchErrors is true. */
+    uint8_t latchDataNack(uint8_t res) const {
+      if (kLatchErrors && ! res) mBusStatus = kStatusDataNack;
+      return res;
+    }
+
+    /** Report a latched NACK of the address byte as an address NACK. */
+    void latchAddressNack() const {
+      if (kLatchErrors && mBusStatus == kStatusDataNack) {
+        mBusStatus = kStatusAddressNack;
+      }
+    }
+
+    /**
+     * Another master drove SDA LOW while this master sent a HIGH bit. Both
+     * lines are already released, so the bus is left to the other master.
+     */
+    void loseArbitration() const {
+      mBusStatus = kStatusArbitrationLost;
+      mOwnsBus = false;
+      mQuantity = 0;
+    }
+
+    /**
+     * Wait for SCL to go HIGH after releasing it, while another master or a
+     * device holds it LOW.
+     */
+    static void waitForClockRelease() {
+      for (uint16_t i = 0; i < kStretchTimeoutMicros; ++i) {
+        if (digitalReadFast(T_CLOCK_PIN) != LOW) break;
+        delayMicroseconds(1);
+      }
+    }
+
     /**
      * Read the ACK/NACK bit from the device which is expected to be set after
      * the falling edge of the 8th CLK, which happens in the write() loop above.
@@ -229,13 +536,27 @@ class SimpleWireFastInterface {
       // change when SCL is HIGH and we expect the slave to abide by that.
       clockHigh();
 
-      uint8_t ack = digitalReadFast(T_DATA_PIN);
+      uint8_t ack = sampleData();
 
       // Device releases SDA upon falling edge of the 9th CLK.
       clockLow();
       return ack;
     }
 
+    /** Read the 8 bits of a byte from the slave, MSB first. */
+    static uint8_t readBits() {
+      dataHigh();
+      uint8_t data = 0;
+      for (uint8_t i = 0; i < 8; ++i) {
+        clockHigh();
+        data <<= 1;
+        uint8_t bit = sampleData();
+        data |= (bit & 0x1);
+        clockLow();
+      }
+      return data;
+    }
+
     /** Send ACK to slave. */
     static void sendAck() {
       dataLow();
@@ -250,21 +571,167 @@ class SimpleWireFastInterface {
       clockLow();
     }
 
-    static void bitDelay() { delayMicroseconds(T_DELAY_MICROS); }
+    /**
+     * Probe the `numAddrs` devices in `addrs` (or 0x08-0x77 if `addrs` is
+     * null) in open-drain mode, and return true if SCL is held LOW while the
+     * bus is idle, or if any device holds SCL LOW while sending the first
+     * byte of a read, or before the STOP condition.
+     */
+    static bool detectClockStretching(const uint8_t* addrs, uint8_t numAddrs) {
+      if (digitalReadFast(T_CLOCK_PIN) == LOW) return true;
+
+      bool stretched = false;
+      uint8_t count = addrs ? numAddrs : 0x78 - 0x08;
+      for (uint8_t i = 0; i < count; ++i) {
+        uint8_t addr = addrs ? addrs[i] : 0x08 + i;
+        SimpleWireFastInterface probe;
+        if (probe.requestFrom(addr, 1) == 0) continue;
+
+        // Read the byte, checking whether SCL is actually released for each
+        // bit, then send the NACK and the STOP condition.
+        dataHigh();
+        for (uint8_t bit = 0; bit < 8; ++bit) {
+          if (releaseClock()) stretched = true;
+          clockLow();
+        }
+        sendNack();
+        dataLow();
+        if (releaseClock()) stretched = true;
+        dataHigh();
+      }
+      return stretched;
+    }
+
+    /**
+     * Release SCL in open-drain mode, and wait for a device which holds it
+     * LOW. Return true if SCL was held LOW.
+     */
+    static bool releaseClock() {
+      pinModeFast(T_CLOCK_PIN, INPUT);
+      bool held = (digitalReadFast(T_CLOCK_PIN) == LOW);
+      if (held) {
+        for (uint16_t i = 0; i < kStretchTimeoutMicros / 10; ++i) {
+          if (digitalReadFast(T_CLOCK_PIN) != LOW) break;
+          delayMicroseconds(10);
+        }
+      }
+      bitDelay();
+      return held;
+    }
+
+    /** Sample the SDA line using the kSampling policy. */
+    static uint8_t sampleData() {
+      return SdaSampler::sample(
+          kSampling,
+          []() { return (uint8_t) digitalReadFast(T_DATA_PIN); },
+          []() { bitDelay(); },
+          []() { halfBitDelay(); });
+    }
 
-    static void clockHigh() { pinModeFast(T_CLOCK_PIN, INPUT); bitDelay(); }
+    /** Select the bit delay of the device at `addr` from T_PROFILE. */
+    static void selectDelay(uint8_t addr) {
+      if (IsDelayProfileEnabled<T_PROFILE>::kValue) {
+        sDelayMicros = T_PROFILE::delayMicros(addr);
+      }
+    }
 
-    static void clockLow() { pinModeFast(T_CLOCK_PIN, OUTPUT); bitDelay(); }
+    static void bitDelay() {
+      if (IsDelayProfileEnabled<T_PROFILE>::kValue) {
+        delayMicroseconds(sDelayMicros);
+      } else {
+        delayMicroseconds(T_DELAY_MICROS);
+      }
+    }
+
+    static void halfBitDelay() {
+      if (IsDelayProfileEnabled<T_PROFILE>::kValue) {
+        delayMicroseconds(sDelayMicros / 2);
+      } else {
+        delayMicroseconds(T_DELAY_MICROS / 2);
+      }
+    }
+
+    static void clockHigh() {
+      if (kPushPull && sPushPull) {
+        digitalWriteFast(T_CLOCK_PIN, HIGH);
+      } else {
+        pinModeFast(T_CLOCK_PIN, INPUT);
+        if (kMultiMaster) waitForClockRelease();
+      }
+      bitDelay();
+    }
+
+    static void clockLow() {
+      if (kPushPull && sPushPull) {
+        digitalWriteFast(T_CLOCK_PIN, LOW);
+      } else {
+        pinModeFast(T_CLOCK_PIN, OUTPUT);
+      }
+      bitDelay();
+    }
 
     static void dataHigh() { pinModeFast(T_DATA_PIN, INPUT); bitDelay(); }
 
     static void dataLow() { pinModeFast(T_DATA_PIN, OUTPUT); bitDelay(); }
 
   private:
+    /** Maximum time to wait for a stretching device to release SCL. */
+    static const uint16_t kStretchTimeoutMicros = 10000;
+
+    /**
+     * Minimum time that both lines must be HIGH before the bus is considered
+     * free, used only if kMultiMaster is true. The bus free time (tBUF)
+     * between a STOP and a START is 4.7 micros in standard mode.
+     */
+    static const uint8_t kBusFreeMicros = 5;
+
+    /** Maximum time to wait for the bus to become free. */
+    static const uint16_t kBusBusyTimeoutMicros = 10000;
+
+    /** Bit delay of the current device, used only with a custom T_PROFILE. */
+    static uint8_t sDelayMicros;
+
+    /** SCL is in push-pull mode, used only if kPushPull is true. */
+    static bool sPushPull;
+
     mutable bool mSendStop;
-    mutable uint8_t mQuantity;
+    mutable uint16_t mQuantity;
+
+    /**
+     * Status of an abandoned transaction or a latched NACK, used only if
+     * kMultiMaster or kLatchErrors.
+     */
+    mutable uint8_t mBusStatus = 0;
+
+    /**
+     * A START has been sent without a STOP, used only if kMultiMaster or
+     * kLatchErrors.
+     */
+    mutable bool mOwnsBus = false;
 };
 
+template <
+    uint8_t T_DATA_PIN,
+    uint8_t T_CLOCK_PIN,
+    uint8_t T_DELAY_MICROS,
+    typename T_OPTIONS,
+    typename T_PROFILE
+>
+uint8_t SimpleWireFastInterface<
+    T_DATA_PIN, T_CLOCK_PIN, T_DELAY_MICROS, T_OPTIONS, T_PROFILE
+>::sDelayMicros = T_DELAY_MICROS;
+
+template <
+    uint8_t T_DATA_PIN,
+    uint8_t T_CLOCK_PIN,
+    uint8_t T_DELAY_MICROS,
+    typename T_OPTIONS,
+    typename T_PROFILE
+>
+bool SimpleWireFastInterface<
+    T_DATA_PIN, T_CLOCK_PIN, T_DELAY_MICROS, T_OPTIONS, T_PROFILE
+>::sPushPull = false;
+
 }
 
 #endif
@@ -27,9 +27,45 @@ SOFTWARE.
 
 #include <stdint.h>
 #include <Arduino.h> // pinMode(), digitalWrite()
+#include "SpeedProfile.h"
+#include "SdaSampler.h"
+#include "Message.h"
+#include "ReadSink.h"
 
 namespace ace_wire {
 
+/**
+ * The default compile-time options of BasicSimpleWireInterface, which disable
+ * all optional features. To enable some of them, derive a class and redefine
+ * only the constants which differ from the defaults, for example:
+ *
+ * @code
+ * struct MyOptions : SimpleWireOptions {
+ *   static const bool kLatchErrors = true;
+ * };
+ * BasicSimpleWireInterface<MyOptions> wireInterface(2, 3, 5);
+ * @endcode
+ */
+struct SimpleWireOptions {
+  /**
+   * Policy for sampling SDA in read() and readAck(), one of the constants in
+   * SdaSampler.
+   */
+  static const uint8_t kSampling = SdaSampler::kOnce;
+
+  /**
+   * Detect the loss of arbitration to another master, and wait for the bus
+   * to become free before a START.
+   */
+  static const bool kMultiMaster = false;
+
+  /**
+   * Latch the first NACK of a transaction, skip the following write() calls,
+   * and return the NACK from endTransmission().
+   */
+  static const bool kLatchErrors = false;
+};
+
 /**
  * A software I2C implementation for sending LED segment patterns over I2C. This
  * has the same API has TwoWireInterface so it can be a drop-in replacement.
@@ -53,9 +89,87 @@ namespace ace_wire {
  * an ACK if 'quantity' has just been read. A STOP condition is also sent after
  * the last byte, if the 'sendStop' flag of requestFrom() was set to be true
  * (default).
+ *
+ * Devices on the same bus often tolerate different speeds. The bit delay can
+ * be selected per device using a compile-time profile `T_PROFILE`, which is a
+ * class with a static `delayMicros(uint8_t addr)` method (see NoDelayProfile),
+ * called by beginTransmission() and requestFrom(). A slow device then no
+ * longer forces every other device on the bus down to its speed. With the
+ * default NoDelayProfile, the `delayMicros` of the constructor is used for
+ * every device, and no lookup is compiled.
+ *
+ * The optional features are selected at compile time by the static constants
+ * of `T_OPTIONS`, so that the disabled features cost neither flash nor RAM.
+ * The SimpleWireInterface alias selects the default SimpleWireOptions.
+ *
+ * The SDA line is normally sampled once right after SCL goes HIGH. On long
+ * cables at small delays, the `kSampling` policy can be set to one of the
+ * filtering policies of SdaSampler instead.
+ *
+ * If another master shares the bus, set the `kMultiMaster` option. Each
+ * START condition (except a repeated START) then waits until both lines have
+ * been HIGH for longer than the bus free time (tBUF) after the STOP of the
+ * other master, and releasing SCL waits for the line to actually go HIGH, so
+ * that the clocks of the masters are synchronized. While sending,
+ * SDA is read back after each HIGH bit. If it is LOW, another master has won
+ * the arbitration: both lines are released immediately, the transaction is
+ * abandoned without a STOP, and endTransmission() returns
+ * kStatusArbitrationLost. If the bus does not become free in time,
+ * endTransmission() returns kStatusBusBusy.
+ *
+ * Normally, write() clocks out every byte even after the device has responded
+ * with a NACK. If the `kLatchErrors` option is set, the first NACK of a
+ * transaction is latched instead: the following write() calls return 0
+ * without touching the bus, and endTransmission() sends the STOP condition
+ * and returns kStatusAddressNack or kStatusDataNack. Probing a missing
+ * device then costs only its address byte.
+ *
+ * @tparam T_OPTIONS the compile-time options, SimpleWireOptions or a class
+ *    derived from it (default SimpleWireOptions)
+ * @tparam T_PROFILE compile-time per-device delay profile (default
+ *    NoDelayProfile which uses the `delayMicros` of the constructor for all
+ *    devices)
  */
-class SimpleWireInterface {
+template <
+    typename T_OPTIONS = SimpleWireOptions,
+    typename T_PROFILE = NoDelayProfile
+>
+class BasicSimpleWireInterface {
+  static const uint8_t kSampling = T_OPTIONS::kSampling;
+  static const bool kMultiMaster = T_OPTIONS::kMultiMaster;
+  static const bool kLatchErrors = T_OPTIONS::kLatchErrors;
+
   public:
+    /**
+     * The `sendStop = false` parameter of endTransmission() and requestFrom()
+     * is honored, so the next transaction begins with a repeated START.
+     */
+    static const bool kSupportsRepeatedStart = true;
+
+    /** Data is sent to the bus immediately by write(). */
+    static const bool kBuffered = false;
+
+    /** No buffer, so the size of a transaction is not limited. */
+    static const uint16_t kBufferSize = 0;
+
+    /** Maximum quantity of requestFrom(). */
+    static const uint16_t kMaxQuantity = 65535;
+
+    /** The beginTransmission() method reports the NACK of the address. */
+    static const bool kReportsAddressNack = true;
+
+    /** Status code of endTransmission() for a latched address NACK. */
+    static const uint8_t kStatusAddressNack = 2;
+
+    /** Status code of endTransmission() for a latched data NACK. */
+    static const uint8_t kStatusDataNack = 3;
+
+    /** Status code of endTransmission() if another master won the bus. */
+    static const uint8_t kStatusArbitrationLost = 4;
+
+    /** Status code of endTransmission() if the bus did not become free. */
+    static const uint8_t kStatusBusBusy = 5;
+
     /**
      * Constructor.
      *
@@ -67,9 +181,10 @@ class SimpleWireInterface {
      *
      * @param dataPin SDA pin
      * @param clockPin SCL pin
-     * @param delayMicros delay after each bit transition of SDA or SCL
+     * @param delayMicros delay after each bit transition of SDA or SCL, until
+     *    a custom `T_PROFILE` selects the delay of the first device
      */
-    explicit SimpleWireInterface(
+    explicit BasicSimpleWireInterface(
         uint8_t dataPin, uint8_t clockPin, uint8_t delayMicros
     ) :
         mDataPin(dataPin),
@@ -101,21 +216,21 @@ class SimpleWireInterface {
     }
 
     /**
-     * Send the I2C START condition.
+     * Send the I2C START condition, using the bit delay of the device at
+     * `addr`.
      *
      * @param addr I2C address of slave device
-     * @return 0 if ACK, 1 if NACK
+     * @return 0 if ACK, 1 if NACK, the bus was busy, or the arbitration was
+     *    lost
      */
     uint8_t beginTransmission(uint8_t addr) const {
-      clockHigh();
-      dataHigh();
-
-      dataLow();
-      clockLow();
+      selectDelay(addr);
+      if (! start()) return 1;
 
       // Send I2C addr (7 bits) and the R/W bit set to "write" (0x00).
       uint8_t effectiveAddr = (addr << 1) | 0x00;
       uint8_t res = write(effectiveAddr);
+      if (! res) latchAddressNack();
       return res ^ 0x1;
     }
 
@@ -127,9 +242,12 @@ class SimpleWireInterface {
      * does not seem to cause any problems with the LED modules that I have
      * tested.
      *
-     * @return 1 if successful with ACK, 0 for NACK.
+     * @return 1 if successful with ACK, 0 for NACK or the loss of arbitration,
+     *    or if an earlier NACK was latched
      */
     uint8_t write(uint8_t data) const {
+      if ((kMultiMaster || kLatchErrors) && mBusStatus) return 0;
+
       for (uint8_t i = 0;  i < 8; ++i) {
         if (data & 0x80) {
           dataHigh();
@@ -137,6 +255,10 @@ class SimpleWireInterface {
           dataLow();
         }
         clockHigh();
+        if (kMultiMaster && (data & 0x80) && digitalRead(mDataPin) == LOW) {
+          loseArbitration();
+          return 0;
+        }
         // An extra bitDelay() here would make the HIGH and LOW states symmetric
         // in duration (if digitalWrite() is assumed to be infinitely fast,
         // which it is definitely not). But actual devices that I have tested
@@ -147,48 +269,68 @@ class SimpleWireInterface {
       }
 
       uint8_t ack = readAck();
+      if (kLatchErrors && ack) mBusStatus = kStatusDataNack;
       return ack ^ 0x1;
     }
 
     /**
-     * Send the I2C STOP condition.
+     * Send the I2C STOP condition. Nothing is sent if the transaction was
+     * abandoned because the bus was busy or the arbitration was lost. A
+     * latched NACK always ends the transaction with the STOP condition,
+     * unless requestFrom() has already sent it.
      *
-     * @return always returns 0 to indicate success
+     * @return 0 upon success, kStatusAddressNack or kStatusDataNack if a NACK
+     *    was latched, kStatusArbitrationLost or kStatusBusBusy
      */
     uint8_t endTransmission(bool sendStop = true) const {
-      // clock will always be LOW when this is called
-      if (sendStop) {
-        dataLow();
-        clockHigh();
-        dataHigh();
+      uint8_t status = 0;
+      if ((kMultiMaster || kLatchErrors) && mBusStatus) {
+        status = mBusStatus;
+        mBusStatus = 0;
+        if (status >= kStatusArbitrationLost) return status;
+        sendStop = mOwnsBus;
       }
 
-      return 0;
+      if (sendStop) stop();
+      return status;
     }
 
     /**
      * Prepare to read bytes by sending I2C START condition. If `sendStop` is
      * true, then a STOP condition will be sent by `read()` after the last byte.
      *
+     * There is no RX buffer, so `quantity` is limited only by its 16-bit
+     * type.
+     *
+     * If the device responds with a NACK, there is nothing for read() to
+     * read, and it returns 0xff without touching the bus. The STOP condition
+     * is sent immediately if `sendStop` is true, even if the NACK was
+     * latched, whose status is still returned by a following
+     * endTransmission().
+     *
      * @return 'quantity' if addr was written successfully and the device
-     * responded with ACK, 0 if device responded with NACK
+     * responded with ACK, 0 if device responded with NACK, the bus was busy,
+     * or the arbitration was lost
      */
-    uint8_t requestFrom(
-        uint8_t addr, uint8_t quantity, bool sendStop = true) const {
-      mQuantity = quantity;
+    uint16_t requestFrom(
+        uint8_t addr, uint16_t quantity, bool sendStop = true) const {
       mSendStop = sendStop;
-
-      clockHigh();
-      dataHigh();
-
-      dataLow();
-      clockLow();
+      selectDelay(addr);
+      mQuantity = 0;
+      if (! start()) return 0;
 
       // Send I2C addr (7 bits) and the R/W bit set to "read" (0x01).
       uint8_t effectiveAddr = (addr << 1) | 0x01;
       uint8_t status = write(effectiveAddr);
+      if (status == 0) {
+        latchAddressNack();
+        bool lost = (kMultiMaster && mBusStatus >= kStatusArbitrationLost);
+        if (sendStop && ! lost) stop();
+        return 0;
+      }
 
-      return (status == 0) ? 0 : quantity;
+      mQuantity = quantity;
+      return quantity;
     }
 
     /**
@@ -208,16 +350,7 @@ class SimpleWireInterface {
       // Caller should not call when mQuantity is 0, but let's guard against it.
       if (! mQuantity) return 0xff;
 
-      // Read one byte
-      dataHigh();
-      uint8_t data = 0;
-      for (uint8_t i = 0; i < 8; ++i) {
-        clockHigh();
-        data <<= 1;
-        uint8_t bit = digitalRead(mDataPin);
-        data |= (bit & 0x1);
-        clockLow();
-      }
+      uint8_t data = readBits();
 
       // Decrement quantity to determine if NACK or ACK should be sent.
       mQuantity--;
@@ -231,14 +364,155 @@ class SimpleWireInterface {
       return data;
     }
 
+    /**
+     * Execute the array of `count` messages as a single combined transaction,
+     * joined by repeated START conditions, with a STOP condition after the
+     * last message. See transferMessages().
+     */
+    TransferResult transfer(const Message* msgs, uint8_t count) const {
+      return transferMessages(*this, msgs, count);
+    }
+
+    /**
+     * Read up to `quantity` bytes (0 for no limit) from the device at `addr`,
+     * passing each byte to the `sink` functor with the signature
+     * `bool(uint8_t data)` as soon as it is received, without any buffer. The
+     * sink is called before the ACK of the byte is sent, so if it returns
+     * false, the byte is answered with a NACK and the transfer ends
+     * immediately. If the device does not respond, the STOP condition is sent
+     * if `sendStop` is true. See also RecordSink.
+     *
+     * @return the number of bytes passed to the sink, 0 if the device did not
+     *    respond
+     */
+    template <typename F>
+    uint32_t readInto(
+        uint8_t addr, uint16_t quantity, F&& sink, bool sendStop = true)
+        const {
+      if (requestFrom(addr, 1, false /*sendStop*/) == 0) {
+        endTransmission(sendStop);
+        return 0;
+      }
+      mQuantity = 0;
+
+      uint32_t count = 0;
+      bool more = true;
+      while (more) {
+        uint8_t data = readBits();
+        count++;
+        more = sink(data) && (quantity == 0 || count < quantity);
+        if (more) {
+          sendAck();
+        } else {
+          sendNack();
+        }
+      }
+      endTransmission(sendStop);
+      return count;
+    }
+
     // Use default copy constructor. Delete the assignment operator because it
-    // cannot work with constant fields (mDataPin, mClockPin, mDelayMicros).
+    // cannot work with constant fields (mDataPin, mClockPin).
     // clang++ 13 prints warnings if the assignment operator is marked
     // 'default', but g++ does not.
-    SimpleWireInterface(const SimpleWireInterface&) = default;
-    SimpleWireInterface& operator=(const SimpleWireInterface&) = delete;
+    BasicSimpleWireInterface(const BasicSimpleWireInterface&) = default;
+    BasicSimpleWireInterface& operator=(const BasicSimpleWireInterface&) =
+        delete;
 
   private:
+    /**
+     * Minimum time that both lines must be HIGH before the bus is considered
+     * free, in addition to 2 bit delays. The bus free time (tBUF) between a
+     * STOP and a START is 4.7 micros in standard mode.
+     */
+    static const uint8_t kBusFreeMicros = 5;
+
+    /** Maximum time to wait for the bus to become free. */
+    static const uint16_t kBusBusyTimeoutMicros = 10000;
+
+    /** Maximum time to wait for another device to release SCL. */
+    static const uint16_t kStretchTimeoutMicros = 10000;
+
+    /**
+     * Send the START condition. With kMultiMaster, a START which is not a
+     * repeated START first waits for the bus to become free.
+     *
+     * @return true if the START condition was sent, false if the bus is busy
+     */
+    bool start() const {
+      if (kMultiMaster || kLatchErrors) mBusStatus = 0;
+      if (kMultiMaster && ! mOwnsBus && ! waitForBusFree()) {
+        mBusStatus = kStatusBusBusy;
+        return false;
+      }
+      if (kMultiMaster || kLatchErrors) mOwnsBus = true;
+
+      clockHigh();
+      dataHigh();
+
+      dataLow();
+      clockLow();
+      return true;
+    }
+
+    /** Send the STOP condition. The clock is always LOW when this is called. */
+    void stop() const {
+      dataLow();
+      clockHigh();
+      dataHigh();
+      mOwnsBus = false;
+    }
+
+    /**
+     * Wait until both SDA and SCL have been HIGH continuously for the bus
+     * free time. Another master in the middle of a transaction pulls SCL LOW
+     * at least once every bit period, which is detected here.
+     *
+     * @return true if the bus is free, false upon timeout
+     */
+    bool waitForBusFree() const {
+      uint16_t freeMicros = kBusFreeMicros + 2 * mDelayMicros;
+      uint16_t idle = 0;
+      for (uint16_t i = 0; i < kBusBusyTimeoutMicros; ++i) {
+        if (digitalRead(mClockPin) == LOW || digitalRead(mDataPin) == LOW) {
+          idle = 0;
+        } else if (++idle >= freeMicros) {
+          return true;
+        }
+        delayMicroseconds(1);
+      }
+      return false;
+    }
+
+    /** Report a latched NACK of the address byte as an address NACK. */
+    void latchAddressNack() const {
+      if (kLatchErrors && mBusStatus == kStatusDataNack) {
+        mBusStatus = kStatusAddressNack;
+      }
+    }
+
+    /**
+     * Another master drove SDA LOW while this master sent a HIGH bit. SDA is
+     * already released, and SCL is still released by the preceding
+     * clockHigh(), so the bus is left to the other master.
+     */
+    void loseArbitration() const {
+      mBusStatus = kStatusArbitrationLost;
+      mOwnsBus = false;
+      mQuantity = 0;
+    }
+
+    /**
+     * Wait for SCL to go HIGH after releasing it, while another master or a
+     * device holds it LOW.
+     */
+    void waitForClockRelease() const {
+      for (uint16_t i = 0; i < kStretchTimeoutMicros; ++i) {
+        if (digitalRead(mClockPin) != LOW) break;
+        delayMicroseconds(1);
+      }
+    }
+
     /**
      * Read the ACK/NACK bit from the device which is expected to be set after
      * the falling edge of the 8th CLK, which happens in the write() loop above.
@@ -253,13 +527,27 @@ class SimpleWireInterface {
       // change when SCL is HIGH and we expect the slave to abide by that.
       clockHigh();
 
-      uint8_t ack = digitalRead(mDataPin);
+      uint8_t ack = sampleData();
 
       // Device releases SDA upon falling edge of the 9th CLK.
       clockLow();
       return ack;
     }
 
+    /** Read the 8 bits of a byte from the slave, MSB first. */
+    uint8_t readBits() const {
+      dataHigh();
+      uint8_t data = 0;
+      for (uint8_t i = 0; i < 8; ++i) {
+        clockHigh();
+        data <<= 1;
+        uint8_t bit = sampleData();
+        data |= (bit & 0x1);
+        clockLow();
+      }
+      return data;
+    }
+
     /** Send ACK (active LOW) to slave. */
     void sendAck() const {
       dataLow();
@@ -274,9 +562,31 @@ class SimpleWireInterface {
       clockLow();
     }
 
+    /** Sample the SDA line using the kSampling policy. */
+    uint8_t sampleData() const {
+      return SdaSampler::sample(
+          kSampling,
+          [this]() { return (uint8_t) digitalRead(mDataPin); },
+          [this]() { bitDelay(); },
+          [this]() { halfBitDelay(); });
+    }
+
+    /** Select the bit delay of the device at `addr` from T_PROFILE. */
+    void selectDelay(uint8_t addr) const {
+      if (IsDelayProfileEnabled<T_PROFILE>::kValue) {
+        mDelayMicros = T_PROFILE::delayMicros(addr);
+      }
+    }
+
     void bitDelay() const { delayMicroseconds(mDelayMicros); }
 
-    void clockHigh() const { pinMode(mClockPin, INPUT); bitDelay(); }
+    void halfBitDelay() const { delayMicroseconds(mDelayMicros / 2); }
+
+    void clockHigh() const {
+      pinMode(mClockPin, INPUT);
+      if (kMultiMaster) waitForClockRelease();
+      bitDelay();
+    }
 
     void clockLow() const { pinMode(mClockPin, OUTPUT); bitDelay(); }
 
@@ -287,12 +597,28 @@ class SimpleWireInterface {
   private:
     uint8_t const mDataPin;
     uint8_t const mClockPin;
-    uint8_t const mDelayMicros;
 
-    mutable uint8_t mQuantity;
+    /** The bit delay, changed by selectDelay() only with a custom T_PROFILE. */
+    mutable uint8_t mDelayMicros;
+    mutable uint16_t mQuantity;
     mutable bool mSendStop;
+
+    /**
+     * Status of an abandoned transaction or a latched NACK, used only if
+     * kMultiMaster or kLatchErrors.
+     */
+    mutable uint8_t mBusStatus = 0;
+
+    /**
+     * A START has been sent without a STOP, used only if kMultiMaster or
+     * kLatchErrors.
+     */
+    mutable bool mOwnsBus = false;
 };
 
+/** The software I2C interface with the default SimpleWireOptions. */
+using SimpleWireInterface = BasicSimpleWireInterface<>;
+
 }
 
 #endif
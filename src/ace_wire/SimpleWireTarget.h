@@ -0,0 +1,311 @@
+/*
+MIT License
+
+Copyright (c) 2022 Brian T. Park
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef ACE_WIRE_SIMPLE_WIRE_TARGET_H
+#define ACE_WIRE_SIMPLE_WIRE_TARGET_H
+
+#include <stdint.h>
+
+namespace ace_wire {
+
+/**
+ * A software implementation of an I2C target (slave) device on any 2 pins,
+ * using the same `digitalReadFast()` and `pinModeFast()` primitives as
+ * SimpleWireFastInterface. It appears on the bus as a device with a window of
+ * `size` registers provided by the caller, with the usual auto-incrementing
+ * register pointer:
+ *
+ *  * A write transaction sets the register pointer with its first data byte,
+ *    then stores the following bytes directly into the register array.
+ *  * A read transaction returns the bytes directly from the register array,
+ *    starting at the register pointer.
+ *
+ * The pointer wraps around at the end of the window. No bytes are copied
+ * through an intermediate buffer.
+ *
+ * The bus is decoded by handleChange(), which must be called from a pin
+ * change interrupt on both SDA and SCL (e.g. the PCINT interrupts of AVR, or
+ * `attachInterrupt()` with `CHANGE` on both pins). It detects the START and
+ * STOP conditions from the SDA edges while SCL is HIGH, samples the incoming
+ * bits on the rising edges of SCL, and drives SDA on the falling edges of SCL.
+ * While it drives SDA, it holds SCL LOW, so if the master releases SCL before
+ * the handler has finished (i.e. the handler fell behind), the clock is
+ * stretched until SDA is valid. Otherwise, the stretching is invisible,
+ * because SCL is already held LOW by the master.
+ *
+ * If both lines are found to have changed in a single call, an edge was
+ * missed. The change of SCL is processed, and the event is counted by
+ * overruns().
+ *
+ * @tparam T_DATA_PIN SDA pin
+ * @tparam T_CLOCK_PIN SCL pin
+ */
+template <uint8_t T_DATA_PIN, uint8_t T_CLOCK_PIN>
+class SimpleWireTarget {
+  public:
+    /**
+     * Constructor.
+     *
+     * @param addr 7-bit I2C address of this target
+     * @param registers the register window, owned by the caller
+     * @param size number of registers in the window, 1 to 256 (0 means 256)
+     */
+    explicit SimpleWireTarget(uint8_t addr, uint8_t* registers, uint16_t size) :
+        mAddr(addr),
+        mRegisters(registers),
+        mSize(size ? size : 256)
+    {}
+
+    /**
+     * Release both lines, and start listening. The pin change interrupts
+     * must be enabled by the caller after this.
+     */
+    void begin() {
+      digitalWriteFast(T_CLOCK_PIN, LOW);
+      digitalWriteFast(T_DATA_PIN, LOW);
+      releaseClock();
+      releaseData();
+      mLines = readLines();
+      mState = kIdle;
+    }
+
+    /** Release both lines and stop responding. */
+    void end() {
+      releaseClock();
+      releaseData();
+      mState = kIdle;
+    }
+
+    /** Decode the bus after a change of SDA or SCL. Call from the ISR. */
+    void handleChange() {
+      uint8_t lines = readLines();
+      uint8_t changed = lines ^ mLines;
+      mLines = lines;
+
+      if (changed & kScl) {
+        if (changed & kSda) mOverruns++;
+        if (lines & kScl) {
+          clockRose(lines & kSda);
+        } else {
+          clockFell();
+        }
+      } else if ((changed & kSda) && (lines & kScl)) {
+        if (lines & kSda) {
+          // STOP condition.
+          releaseData();
+          mState = kIdle;
+        } else {
+          // START or repeated START condition.
+          releaseData();
+          mState = kAddress;
+          mShift = 0;
+          mBitCount = 0;
+        }
+      }
+    }
+
+    /** Return the current register pointer. */
+    uint8_t pointer() const { return mPointer; }
+
+    /** Return true if this target is addressed in the current transaction. */
+    bool isSelected() const {
+      return mState != kIdle && mState != kAddress && mState != kIgnore;
+    }
+
+    /** Number of calls to handleChange() in which an edge was missed. */
+    uint16_t overruns() const { return mOverruns; }
+
+    // Delete the copy constructor and assignment operator because this object
+    // holds the state of the interrupt handler.
+    SimpleWireTarget(const SimpleWireTarget&) = delete;
+    SimpleWireTarget& operator=(const SimpleWireTarget&) = delete;
+
+  private:
+    // Bits returned by readLines().
+    static const uint8_t kSda = 0x01;
+    static const uint8_t kScl = 0x02;
+
+    // States of the decoder.
+    static const uint8_t kIdle = 0; // waiting for a START
+    static const uint8_t kAddress = 1; // receiving the address byte
+    static const uint8_t kReceive = 2; // receiving a data byte
+    static const uint8_t kTransmit = 3; // sending a data byte
+    static const uint8_t kAckOut = 4; // sending the ACK bit
+    static const uint8_t kAckIn = 5; // receiving the ACK bit of the master
+    static const uint8_t kIgnore = 6; // not addressed, waiting for START/STOP
+
+    static uint8_t readLines() {
+      return (digitalReadFast(T_DATA_PIN) ? kSda : 0)
+          | (digitalReadFast(T_CLOCK_PIN) ? kScl : 0);
+    }
+
+    static void holdClock() { pinModeFast(T_CLOCK_PIN, OUTPUT); }
+    static void releaseClock() { pinModeFast(T_CLOCK_PIN, INPUT); }
+    void pullData() {
+      pinModeFast(T_DATA_PIN, OUTPUT);
+      syncData();
+    }
+
+    void releaseData() {
+      pinModeFast(T_DATA_PIN, INPUT);
+      syncData();
+    }
+
+    /**
+     * Record the new level of SDA after changing it, so that the pin change
+     * interrupt caused by this target is not mistaken for a missed edge. The
+     * SCL bit is left alone, so that a rising edge of SCL which happened in
+     * the meantime is still processed by the next call.
+     */
+    void syncData() {
+      mLines = (mLines & ~kSda) | (digitalReadFast(T_DATA_PIN) ? kSda : 0);
+    }
+
+    /** Sample the bit on the rising edge of SCL. */
+    void clockRose(bool sda) {
+      if (mState == kAddress || mState == kReceive) {
+        mShift = (mShift << 1) | (sda ? 1 : 0);
+        mBitCount++;
+      } else if (mState == kAckIn) {
+        mNack = sda;
+      }
+    }
+
+    /** Prepare SDA for the next bit on the falling edge of SCL. */
+    void clockFell() {
+      switch (mState) {
+        case kAddress:
+          if (mBitCount < 8) return;
+          if ((mShift >> 1) != mAddr) {
+            mState = kIgnore;
+            return;
+          }
+          mReading = mShift & 0x01;
+          mFirstByte = true;
+          sendAck();
+          break;
+
+        case kReceive:
+          if (mBitCount < 8) return;
+          if (mFirstByte) {
+            mPointer = wrap(mShift);
+            mFirstByte = false;
+          } else {
+            mRegisters[mPointer] = mShift;
+            mPointer = wrap(mPointer + 1);
+          }
+          sendAck();
+          break;
+
+        case kAckOut:
+          holdClock();
+          releaseData();
+          if (mReading) {
+            loadByte();
+          } else {
+            mState = kReceive;
+            mShift = 0;
+            mBitCount = 0;
+          }
+          releaseClock();
+          break;
+
+        case kTransmit:
+          holdClock();
+          if (mBitCount < 8) {
+            sendBit();
+          } else {
+            releaseData();
+            mState = kAckIn;
+          }
+          releaseClock();
+          break;
+
+        case kAckIn:
+          if (mNack) {
+            mState = kIgnore;
+            return;
+          }
+          holdClock();
+          loadByte();
+          releaseClock();
+          break;
+
+        default:
+          break;
+      }
+    }
+
+    /** Pull SDA LOW for the ACK bit. */
+    void sendAck() {
+      holdClock();
+      pullData();
+      mState = kAckOut;
+      releaseClock();
+    }
+
+    /** Fetch the register at the pointer, and drive its first bit. */
+    void loadByte() {
+      mShift = mRegisters[mPointer];
+      mPointer = wrap(mPointer + 1);
+      mBitCount = 0;
+      mState = kTransmit;
+      sendBit();
+    }
+
+    /** Drive the next bit of mShift, MSB first. */
+    void sendBit() {
+      if (mShift & 0x80) {
+        releaseData();
+      } else {
+        pullData();
+      }
+      mShift <<= 1;
+      mBitCount++;
+    }
+
+    /** Wrap the register pointer at the end of the window. */
+    uint8_t wrap(uint16_t pointer) const {
+      return (pointer >= mSize) ? pointer % mSize : pointer;
+    }
+
+  private:
+    uint8_t const mAddr;
+    uint8_t* const mRegisters;
+    uint16_t const mSize;
+
+    volatile uint8_t mPointer = 0;
+    volatile uint16_t mOverruns = 0;
+    uint8_t mLines = 0;
+    uint8_t mState = kIdle;
+    uint8_t mShift = 0;
+    uint8_t mBitCount = 0;
+    bool mReading = false;
+    bool mFirstByte = false;
+    bool mNack = false;
+};
+
+}
+
+#endif
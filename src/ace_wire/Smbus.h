@@ -0,0 +1,345 @@
+/*
+MIT License
+
+Copyright (c) 2022 Brian T. Park
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef ACE_WIRE_SMBUS_H
+#define ACE_WIRE_SMBUS_H
+
+#include <stdint.h>
+#include "SmbusPec.h"
+#include "WireTraits.h"
+
+namespace ace_wire {
+
+/**
+ * The SMBus protocols implemented on top of any AceWire interface
+ * (`T_WIREI`), with optional Packet Error Code (PEC) checking. The PEC is
+ * calculated by SmbusPec one byte at a time as each byte is written to or read
+ * from the interface, so no extra buffer or extra pass over the data is
+ * needed.
+ *
+ * The methods return the status codes of endTransmission(), with the addition
+ * of the following:
+ *
+ *  * 0: success
+ *  * 1: block length too long for the caller's buffer, or for SMBus
+ *  * 2: address send, NACK received
+ *  * 3: data send, NACK received
+ *  * 4: other twi error (lost bus arbitration, bus error, ..)
+ *  * 6: PEC received from the device does not match
+ *
+ * The Block Read protocol sends the length of the block in the first byte, but
+ * the AceWire API requires the number of bytes to be known in requestFrom().
+ * So blockRead() requests the maximum number of bytes that the caller can
+ * accept, and ignores the bytes after the block (and PEC). Most SMBus devices
+ * return 0xFF for those extra bytes. The request is limited to
+ * WireTraits<T_WIREI>::kMaxQuantity bytes, including the byte count and the
+ * PEC, so a buffered interface (e.g. TwoWireInterface with 32 bytes on AVR)
+ * may not be able to read the largest blocks.
+ *
+ * The quick command is supported only in its "write" form, which is commonly
+ * used to probe for the presence of a device.
+ *
+ * @tparam T_WIREI the AceWire interface class, e.g. SimpleWireInterface
+ */
+template <typename T_WIREI>
+class Smbus {
+  public:
+    /** Status code returned if the PEC from the device does not match. */
+    static const uint8_t kStatusPecError = 6;
+
+    /** Maximum number of data bytes in an SMBus block. */
+    static const uint8_t kMaxBlockLength = 32;
+
+    /**
+     * Constructor.
+     *
+     * @param wireInterface instance of the AceWire interface
+     * @param usePec send the PEC byte on writes, and verify the PEC byte on
+     *    reads (default true)
+     */
+    explicit Smbus(const T_WIREI& wireInterface, bool usePec = true) :
+        mWireInterface(wireInterface),
+        mUsePec(usePec)
+    {}
+
+    /** Quick Command (write): send only the address. */
+    uint8_t quickCommand(uint8_t addr) const {
+      if (mWireInterface.beginTransmission(addr)) {
+        mWireInterface.endTransmission();
+        return 2;
+      }
+      return mWireInterface.endTransmission();
+    }
+
+    /** Send Byte: send a single data byte without a command code. */
+    uint8_t sendByte(uint8_t addr, uint8_t data) const {
+      uint8_t crc;
+      uint8_t status = beginWrite(addr, crc);
+      if (status) return status;
+      putByte(data, status, crc);
+      return endWrite(status, crc, true);
+    }
+
+    /** Receive Byte: read a single data byte without a command code. */
+    uint8_t receiveByte(uint8_t addr, uint8_t& data) const {
+      uint8_t crc = 0;
+      uint8_t status = beginRead(addr, 1, crc);
+      if (status) return status;
+      data = getByte(crc);
+      return endRead(crc);
+    }
+
+    /** Write Byte: send the command code, then one data byte. */
+    uint8_t writeByte(uint8_t addr, uint8_t command, uint8_t data) const {
+      uint8_t crc;
+      uint8_t status = beginWrite(addr, crc);
+      if (status) return status;
+      putByte(command, status, crc);
+      putByte(data, status, crc);
+      return endWrite(status, crc, true);
+    }
+
+    /** Write Word: send the command code, then 2 data bytes, LSB first. */
+    uint8_t writeWord(uint8_t addr, uint8_t command, uint16_t data) const {
+      uint8_t crc;
+      uint8_t status = beginWrite(addr, crc);
+      if (status) return status;
+      putByte(command, status, crc);
+      putByte((uint8_t) data, status, crc);
+      putByte((uint8_t) (data >> 8), status, crc);
+      return endWrite(status, crc, true);
+    }
+
+    /** Read Byte: send the command code, then read one data byte. */
+    uint8_t readByte(uint8_t addr, uint8_t command, uint8_t& data) const {
+      uint8_t crc;
+      uint8_t status = writeCommand(addr, command, crc);
+      if (status) return status;
+      status = beginRead(addr, 1, crc);
+      if (status) return status;
+      data = getByte(crc);
+      return endRead(crc);
+    }
+
+    /** Read Word: send the command code, then read 2 data bytes, LSB first. */
+    uint8_t readWord(uint8_t addr, uint8_t command, uint16_t& data) const {
+      uint8_t crc;
+      uint8_t status = writeCommand(addr, command, crc);
+      if (status) return status;
+      status = beginRead(addr, 2, crc);
+      if (status) return status;
+      return readWordAndPec(data, crc);
+    }
+
+    /**
+     * Process Call: send the command code and 2 data bytes, then read 2 data
+     * bytes, in a single transaction joined by a repeated START.
+     */
+    uint8_t processCall(
+        uint8_t addr, uint8_t command, uint16_t dataOut, uint16_t& dataIn)
+        const {
+      uint8_t crc;
+      uint8_t status = beginWrite(addr, crc);
+      if (status) return status;
+      putByte(command, status, crc);
+      putByte((uint8_t) dataOut, status, crc);
+      putByte((uint8_t) (dataOut >> 8), status, crc);
+      status = endWrite(status, crc, false, false);
+      if (status) return status;
+
+      status = beginRead(addr, 2, crc);
+      if (status) return status;
+      return readWordAndPec(dataIn, crc);
+    }
+
+    /**
+     * Block Write: send the command code, the byte count, then `len` data
+     * bytes.
+     *
+     * @return 0 upon success, 1 if `len` is larger than kMaxBlockLength, or
+     *    another status code
+     */
+    uint8_t blockWrite(
+        uint8_t addr, uint8_t command, const uint8_t* buf, uint8_t len) const {
+      if (len > kMaxBlockLength) return 1;
+
+      uint8_t crc;
+      uint8_t status = beginWrite(addr, crc);
+      if (status) return status;
+      putByte(command, status, crc);
+      putByte(len, status, crc);
+      for (uint8_t i = 0; i < len; ++i) {
+        putByte(buf[i], status, crc);
+      }
+      return endWrite(status, crc, true);
+    }
+
+    /**
+     * Block Read: send the command code, then read the byte count and the
+     * data bytes into `buf`.
+     *
+     * @param addr I2C address of the device
+     * @param command the command code
+     * @param buf destination buffer of at least `maxLen` bytes
+     * @param maxLen size of buf
+     * @param len set to the number of bytes in the block
+     *
+     * @return 0 upon success, 1 if the block is larger than `maxLen` (after
+     *    limiting it to kMaxBlockLength and to the kMaxQuantity of the
+     *    interface), or another status code
+     */
+    uint8_t blockRead(
+        uint8_t addr, uint8_t command, uint8_t* buf, uint8_t maxLen,
+        uint8_t& len) const {
+      len = 0;
+      maxLen = maxBlockRead(maxLen);
+      uint8_t crc;
+      uint8_t status = writeCommand(addr, command, crc);
+      if (status) return status;
+
+      // Request the byte count, up to maxLen data bytes, and the PEC.
+      uint16_t quantity = (uint16_t) maxLen + 1;
+      status = beginRead(addr, quantity, crc);
+      if (status) return status;
+
+      uint8_t count = getByte(crc);
+      uint16_t remaining = quantity - 1 + (mUsePec ? 1 : 0);
+      status = (count > maxLen) ? 1 : 0;
+      for (uint16_t i = 0; i < remaining; ++i) {
+        uint8_t data = mWireInterface.read();
+        if (status) continue; // drain the bytes that were requested
+        if (i < count) {
+          buf[i] = data;
+          crc = SmbusPec::update(crc, data);
+        } else if (mUsePec && i == count) {
+          if (data != crc) status = kStatusPecError;
+        }
+      }
+      if (status == 0) len = count;
+      return status;
+    }
+
+    // Use default copy constructor. Delete the assignment operator because it
+    // cannot work with constant fields.
+    Smbus(const Smbus&) = default;
+    Smbus& operator=(const Smbus&) = delete;
+
+  private:
+    /**
+     * Limit the number of data bytes of a block read, so that the byte count,
+     * the data and the PEC fit into a single requestFrom().
+     */
+    uint8_t maxBlockRead(uint8_t maxLen) const {
+      if (maxLen > kMaxBlockLength) maxLen = kMaxBlockLength;
+      uint16_t overhead = mUsePec ? 2 : 1;
+      uint16_t limit = WireTraits<T_WIREI>::kMaxQuantity;
+      if ((uint16_t) maxLen + overhead > limit) {
+        maxLen = (limit > overhead) ? (uint8_t) (limit - overhead) : 0;
+      }
+      return maxLen;
+    }
+
+    /** Send the write address, initializing the crc. */
+    uint8_t beginWrite(uint8_t addr, uint8_t& crc) const {
+      crc = SmbusPec::update(0, addr << 1);
+      if (mWireInterface.beginTransmission(addr)) {
+        mWireInterface.endTransmission();
+        return 2;
+      }
+      return 0;
+    }
+
+    /** Write the data byte and update the crc, unless status is non-zero. */
+    void putByte(uint8_t data, uint8_t& status, uint8_t& crc) const {
+      if (status) return;
+      crc = SmbusPec::update(crc, data);
+      if (! mWireInterface.write(data)) status = 3;
+    }
+
+    /**
+     * Send the PEC (if enabled and `sendPec` is true), then end the
+     * transmission. A failed transmission always sends a STOP.
+     */
+    uint8_t endWrite(
+        uint8_t status, uint8_t crc, bool sendStop, bool sendPec = true)
+        const {
+      if (status == 0 && sendPec && mUsePec) {
+        if (! mWireInterface.write(crc)) status = 3;
+      }
+      uint8_t endStatus = mWireInterface.endTransmission(
+          status ? true : sendStop);
+      return status ? status : endStatus;
+    }
+
+    /**
+     * Send the address and the command code, followed by a repeated START.
+     * The crc is carried over to the read phase.
+     */
+    uint8_t writeCommand(uint8_t addr, uint8_t command, uint8_t& crc) const {
+      uint8_t status = beginWrite(addr, crc);
+      if (status) return status;
+      putByte(command, status, crc);
+      return endWrite(status, crc, false, false);
+    }
+
+    /**
+     * Request `quantity` data bytes, plus the PEC byte if enabled, and add the
+     * read address to the crc.
+     */
+    uint8_t beginRead(uint8_t addr, uint16_t quantity, uint8_t& crc) const {
+      crc = SmbusPec::update(crc, (addr << 1) | 0x01);
+      if (mUsePec) quantity++;
+      if (mWireInterface.requestFrom(addr, quantity) == 0) return 2;
+      return 0;
+    }
+
+    /** Read a data byte and update the crc. */
+    uint8_t getByte(uint8_t& crc) const {
+      uint8_t data = mWireInterface.read();
+      crc = SmbusPec::update(crc, data);
+      return data;
+    }
+
+    /** Read the PEC byte (if enabled) and verify it against the crc. */
+    uint8_t endRead(uint8_t crc) const {
+      if (! mUsePec) return 0;
+      return (mWireInterface.read() == crc) ? 0 : kStatusPecError;
+    }
+
+    /** Read 2 data bytes, LSB first, then verify the PEC. */
+    uint8_t readWordAndPec(uint16_t& data, uint8_t& crc) const {
+      uint8_t lsb = getByte(crc);
+      uint8_t msb = getByte(crc);
+      data = ((uint16_t) msb << 8) | lsb;
+      return endRead(crc);
+    }
+
+  private:
+    T_WIREI mWireInterface; // copied by value
+    bool const mUsePec;
+};
+
+}
+
+#endif
@@ -0,0 +1,262 @@
+/*
+MIT License
+
+Copyright (c) 2022 Brian T. Park
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef ACE_WIRE_SPEED_CALIBRATOR_H
+#define ACE_WIRE_SPEED_CALIBRATOR_H
+
+#include <stdint.h>
+
+namespace ace_wire {
+
+/** Error statistics of a single speed step of SpeedCalibrator. */
+struct SpeedCalibrationStats {
+  /**
+   * Number of write/read-back trials performed. The trials of a step stop at
+   * the first failure.
+   */
+  uint16_t trials;
+
+  /** Number of trials which failed with a bus error (e.g. a NACK). */
+  uint16_t busErrors;
+
+  /** Number of trials which read back data different from what was written. */
+  uint16_t dataErrors;
+};
+
+/**
+ * Find the fastest reliable speed of a single device, by sweeping through a
+ * list of speed settings from the slowest to the fastest, and performing a
+ * number of verified write and read-back trials at each step. This is intended
+ * to be run once when a board is commissioned, to replace a conservative guess
+ * of `DELAY_MICROS` with a measured value.
+ *
+ * The speed settings are abstracted as a "step" from 0 (slowest) to
+ * `numSteps - 1` (fastest). The application supplies a factory function which
+ * creates an instance of `T_WIREI` configured for each step, for example:
+ *
+ * @code
+ * const uint8_t DELAYS[] = {10, 5, 4, 3, 2, 1, 0};
+ *
+ * SimpleWireInterface makeInterface(uint8_t step) {
+ *   return SimpleWireInterface(SDA_PIN, SCL_PIN, DELAYS[step]);
+ * }
+ * @endcode
+ *
+ * For `TwoWireInterface`, the factory would call `Wire.setClock()`. For
+ * `SimpleWireFastInterface`, the factory can modify a global variable which is
+ * returned by a custom `T_PROFILE` (see SpeedProfile.h).
+ *
+ * The trials write `len` bytes of test patterns to the registers starting at
+ * `reg`, then read them back. These must be plain read/write registers (e.g.
+ * the alarm registers 0x07-0x0D of a DS3231) whose value is not modified by
+ * the device, and which can tolerate being written many times (i.e. not an
+ * EEPROM). The original contents of the registers are restored at the
+ * slowest step after the sweep, and the calibration fails if they cannot be.
+ *
+ * @tparam T_WIREI the AceWire interface class, e.g. SimpleWireInterface
+ */
+template <typename T_WIREI>
+class SpeedCalibrator {
+  public:
+    /** Returned by calibrate() if even the slowest step fails. */
+    static const uint8_t kNoStep = 0xFF;
+
+    /** Maximum number of bytes in the register window. */
+    static const uint8_t kMaxLen = 16;
+
+    /** Function which returns the interface configured for the given step. */
+    typedef T_WIREI (*Factory)(uint8_t step);
+
+    /**
+     * Constructor.
+     *
+     * @param factory creates the interface object for each step
+     * @param numSteps number of speed steps, from 0 (slowest) to
+     *    `numSteps - 1` (fastest)
+     * @param addr I2C address of the device
+     * @param reg address of the first register of the test window
+     * @param len number of registers in the test window, at most kMaxLen
+     */
+    explicit SpeedCalibrator(
+        Factory factory,
+        uint8_t numSteps,
+        uint8_t addr,
+        uint8_t reg,
+        uint8_t len
+    ) :
+        mFactory(factory),
+        mNumSteps(numSteps),
+        mAddr(addr),
+        mReg(reg),
+        mLen((len > kMaxLen) ? kMaxLen : len)
+    {}
+
+    /**
+     * Sweep through the steps from the slowest, performing up to `trials`
+     * write/read-back trials at each step, until a trial fails.
+     *
+     * @param trials number of trials per step
+     * @param margin number of steps to back off from the fastest passing step
+     * @param stats optional array of `numSteps` entries which receives the
+     *    error statistics of each step. The steps faster than the first
+     *    failing step are not tried, and their `trials` is 0.
+     *
+     * @return the recommended step, which is the fastest step such that it
+     *    and all slower steps passed every trial, minus the `margin` (but not
+     *    below 0). Returns kNoStep if the slowest step failed, or if the
+     *    original register contents could not be read or restored.
+     */
+    uint8_t calibrate(
+        uint16_t trials,
+        uint8_t margin,
+        SpeedCalibrationStats* stats = nullptr
+    ) const {
+      uint8_t saved[kMaxLen];
+      T_WIREI slowest = mFactory(0);
+      slowest.begin();
+      if (readRegisters(slowest, saved)) return kNoStep;
+
+      // Stop at the first failing step. The faster steps cannot raise the
+      // result, and a corrupted register address at those speeds could write
+      // the test pattern outside of the window, which is not restored.
+      uint8_t passed = 0; // number of consecutive passing steps from 0
+      for (uint8_t step = 0; step < mNumSteps; ++step) {
+        SpeedCalibrationStats stepStats = {0, 0, 0};
+        if (passed == step) {
+          T_WIREI wireInterface = mFactory(step);
+          wireInterface.begin();
+          // A single failure decides the step, so skip the remaining trials,
+          // which would only write more patterns at an unreliable speed.
+          bool ok = true;
+          for (uint16_t i = 0; ok && i < trials; ++i) {
+            ok = runTrial(wireInterface, step, i, stepStats);
+          }
+          if (ok) passed = step + 1;
+        }
+        if (stats) stats[step] = stepStats;
+      }
+
+      // Restore the original contents of the registers. The slowest interface
+      // must be reinitialized, since the other steps may have changed the
+      // shared state of the bus (e.g. the clock of TwoWire). If that fails,
+      // the device is left with a test pattern, which the caller must know.
+      if (restoreRegisters(saved)) return kNoStep;
+
+      if (passed == 0) return kNoStep;
+      uint8_t fastest = passed - 1;
+      return (fastest > margin) ? fastest - margin : 0;
+    }
+
+    // Use default copy constructor. Delete the assignment operator because it
+    // cannot work with constant fields.
+    SpeedCalibrator(const SpeedCalibrator&) = default;
+    SpeedCalibrator& operator=(const SpeedCalibrator&) = delete;
+
+  private:
+    /**
+     * Write a test pattern and read it back. The pattern varies with each
+     * trial and step, and mixes 0x55/0xAA (alternating bits) with a counter,
+     * so that every bit is exercised in both directions.
+     *
+     * @return true if the pattern was read back correctly
+     */
+    bool runTrial(
+        const T_WIREI& wireInterface,
+        uint8_t step,
+        uint16_t trial,
+        SpeedCalibrationStats& stats
+    ) const {
+      uint8_t pattern[kMaxLen];
+      uint8_t seed = (uint8_t) (trial * 37 + step);
+      for (uint8_t i = 0; i < mLen; ++i) {
+        pattern[i] = ((i & 1) ? 0xAA : 0x55) ^ (uint8_t) (seed + i * 29);
+      }
+
+      stats.trials++;
+      uint8_t readBack[kMaxLen];
+      if (writeRegisters(wireInterface, pattern)
+          || readRegisters(wireInterface, readBack)) {
+        stats.busErrors++;
+        return false;
+      }
+      for (uint8_t i = 0; i < mLen; ++i) {
+        if (readBack[i] != pattern[i]) {
+          stats.dataErrors++;
+          return false;
+        }
+      }
+      return true;
+    }
+
+    /**
+     * Write `saved` to the register window at the slowest step. Return 0
+     * upon success.
+     */
+    uint8_t restoreRegisters(const uint8_t* saved) const {
+      T_WIREI slowest = mFactory(0);
+      slowest.begin();
+      return writeRegisters(slowest, saved);
+    }
+
+    /** Write the register window. Return 0 upon success. */
+    uint8_t writeRegisters(const T_WIREI& wireInterface, const uint8_t* buf)
+        const {
+      uint8_t status = wireInterface.beginTransmission(mAddr) ? 2 : 0;
+      if (status == 0 && ! wireInterface.write(mReg)) status = 3;
+      for (uint8_t i = 0; status == 0 && i < mLen; ++i) {
+        if (! wireInterface.write(buf[i])) status = 3;
+      }
+      uint8_t endStatus = wireInterface.endTransmission();
+      return status ? status : endStatus;
+    }
+
+    /** Read the register window. Return 0 upon success. */
+    uint8_t readRegisters(const T_WIREI& wireInterface, uint8_t* buf) const {
+      uint8_t status = wireInterface.beginTransmission(mAddr) ? 2 : 0;
+      if (status == 0 && ! wireInterface.write(mReg)) status = 3;
+      uint8_t endStatus = wireInterface.endTransmission(status != 0);
+      if (status) return status;
+      if (endStatus) return endStatus;
+
+      if (wireInterface.requestFrom(mAddr, mLen) == 0) {
+        wireInterface.endTransmission();
+        return 2;
+      }
+      for (uint8_t i = 0; i < mLen; ++i) {
+        buf[i] = wireInterface.read();
+      }
+      return 0;
+    }
+
+  private:
+    Factory const mFactory;
+    uint8_t const mNumSteps;
+    uint8_t const mAddr;
+    uint8_t const mReg;
+    uint8_t const mLen;
+};
+
+}
+
+#endif
@@ -0,0 +1,186 @@
+/*
+MIT License
+
+Copyright (c) 2022 Brian T. Park
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef ACE_WIRE_SPEED_PROFILE_H
+#define ACE_WIRE_SPEED_PROFILE_H
+
+#include <stdint.h>
+
+namespace ace_wire {
+
+/**
+ * An entry in a table of per-device bit delays, which a custom `T_PROFILE` of
+ * SimpleWireInterface or SimpleWireFastInterface can look up with
+ * findDelayMicros(), and which RateController can adjust at runtime.
+ */
+struct DelayProfile {
+  /** I2C address of the device. */
+  uint8_t addr;
+
+  /** Delay after each bit transition of SDA or SCL for this device. */
+  uint8_t delayMicros;
+};
+
+/**
+ * Return the delayMicros of `addr` in the `profiles` table, or
+ * `defaultDelayMicros` if the device is not in the table. The table is
+ * expected to be small, so a linear search is used.
+ */
+inline uint8_t findDelayMicros(
+    const DelayProfile* profiles, uint8_t numProfiles,
+    uint8_t addr, uint8_t defaultDelayMicros) {
+  for (uint8_t i = 0; i < numProfiles; ++i) {
+    if (profiles[i].addr == addr) return profiles[i].delayMicros;
+  }
+  return defaultDelayMicros;
+}
+
+/**
+ * The default compile-time delay profile of BasicSimpleWireInterface and
+ * SimpleWireFastInterface, which uses the fixed delay of the interface for
+ * every device. A custom profile is a class with a single static method which
+ * maps the address of the device to its delay, for example:
+ *
+ * @code
+ * struct MyDelays {
+ *   static uint8_t delayMicros(uint8_t addr) {
+ *     return (addr == 0x68) ? 10 : 2; // slow RTC, fast everything else
+ *   }
+ * };
+ * @endcode
+ */
+struct NoDelayProfile {
+  static uint8_t delayMicros(uint8_t /*addr*/) { return 0; }
+};
+
+/** Determine if T_PROFILE is a custom compile-time delay profile. */
+template <typename T_PROFILE>
+struct IsDelayProfileEnabled {
+  static const bool kValue = true;
+};
+
+template <>
+struct IsDelayProfileEnabled<NoDelayProfile> {
+  static const bool kValue = false;
+};
+
+/**
+ * The default compile-time clock profile of TwoWireInterface, which leaves the
+ * clock speed of the bus alone. A custom profile is a class with a single
+ * static method which sets the clock speed of `wire` for the device at
+ * `addr`, normally through a ClockSelector:
+ *
+ * @code
+ * ClockSelector clockSelector(CLOCK_PROFILES, 2, 100000);
+ *
+ * struct MyClocks {
+ *   static void selectClock(TwoWire& wire, uint8_t addr) {
+ *     clockSelector.select(wire, addr);
+ *   }
+ * };
+ * @endcode
+ */
+struct NoClockProfile {
+  template <typename T_WIRE>
+  static void selectClock(T_WIRE& /*wire*/, uint8_t /*addr*/) {}
+};
+
+/** An entry in the table of per-device clock speeds used by ClockSelector. */
+struct ClockProfile {
+  /** I2C address of the device. */
+  uint8_t addr;
+
+  /** Clock speed in Hz for this device, passed to `setClock()`. */
+  uint32_t clock;
+};
+
+/**
+ * Select the clock speed of a hardware I2C library (e.g. `TwoWire`) according
+ * to the device address of each transaction, calling `setClock()` only when
+ * the speed actually changes.
+ *
+ * The application owns a single instance of this class for each bus, and
+ * calls its select() from the `T_PROFILE` of the interface class (e.g.
+ * TwoWireInterface). Since the interface objects are copied by value into
+ * each device driver, the current clock speed must be stored here, so that
+ * all copies agree on the state of the bus. If the application calls
+ * `setClock()` directly on the underlying object, it must call reset()
+ * afterwards.
+ */
+class ClockSelector {
+  public:
+    /**
+     * Constructor.
+     *
+     * @param profiles table of device addresses and clock speeds, owned by the
+     *    caller
+     * @param numProfiles number of entries in `profiles`
+     * @param defaultClock clock speed in Hz for devices not in `profiles`
+     */
+    explicit ClockSelector(
+        const ClockProfile* profiles,
+        uint8_t numProfiles,
+        uint32_t defaultClock
+    ) :
+        mProfiles(profiles),
+        mNumProfiles(numProfiles),
+        mDefaultClock(defaultClock)
+    {}
+
+    /** Set the clock of `wire` for the device at `addr` if necessary. */
+    template <typename T_WIRE>
+    void select(T_WIRE& wire, uint8_t addr) {
+      uint32_t clock = findClock(addr);
+      if (clock != mClock) {
+        wire.setClock(clock);
+        mClock = clock;
+      }
+    }
+
+    /** Return the clock speed of the device at `addr`. */
+    uint32_t findClock(uint8_t addr) const {
+      for (uint8_t i = 0; i < mNumProfiles; ++i) {
+        if (mProfiles[i].addr == addr) return mProfiles[i].clock;
+      }
+      return mDefaultClock;
+    }
+
+    /** Forget the current clock speed, so that the next select() sets it. */
+    void reset() { mClock = 0; }
+
+    // Disable the copy constructor and assignment operator, because the
+    // interface objects must all point to the same instance.
+    ClockSelector(const ClockSelector&) = delete;
+    ClockSelector& operator=(const ClockSelector&) = delete;
+
+  private:
+    const ClockProfile* const mProfiles;
+    uint8_t const mNumProfiles;
+    uint32_t const mDefaultClock;
+    uint32_t mClock = 0;
+};
+
+}
+
+#endif
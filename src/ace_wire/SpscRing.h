@@ -0,0 +1,112 @@
+/*
+MIT License
+
+Copyright (c) 2022 Brian T. Park
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef ACE_WIRE_SPSC_RING_H
+#define ACE_WIRE_SPSC_RING_H
+
+#include <stdint.h>
+
+namespace ace_wire {
+
+/**
+ * A lock-free ring buffer of `T_SIZE` items of type `T`, for exactly one
+ * producer and one consumer, which may run on different cores (or threads).
+ * The head index is written only by the producer, and the tail index only by
+ * the consumer. Each side publishes its index with a release store after
+ * touching the item, and reads the index of the other side with an acquire
+ * load before touching the item, so no lock or disabled interrupts are needed.
+ *
+ * The indexes are free-running 8-bit counters, so `T_SIZE` must be a power of
+ * 2, at most 128.
+ *
+ * @tparam T type of the item, copied by value
+ * @tparam T_SIZE capacity of the ring
+ */
+template <typename T, uint8_t T_SIZE>
+class SpscRing {
+  static_assert((T_SIZE & (T_SIZE - 1)) == 0 && T_SIZE <= 128,
+      "T_SIZE must be a power of 2, at most 128");
+
+  public:
+    /** Producer: return a pointer to the next free item, or nullptr if full. */
+    T* reserve() {
+      uint8_t head = __atomic_load_n(&mHead, __ATOMIC_RELAXED);
+      uint8_t tail = __atomic_load_n(&mTail, __ATOMIC_ACQUIRE);
+      if ((uint8_t) (head - tail) >= T_SIZE) return nullptr;
+      return &mItems[head & (T_SIZE - 1)];
+    }
+
+    /** Producer: publish the item returned by reserve(). */
+    void commit() {
+      uint8_t head = __atomic_load_n(&mHead, __ATOMIC_RELAXED);
+      __atomic_store_n(&mHead, (uint8_t) (head + 1), __ATOMIC_RELEASE);
+    }
+
+    /** Producer: copy the item into the ring. Returns false if full. */
+    bool push(const T& item) {
+      T* slot = reserve();
+      if (! slot) return false;
+      *slot = item;
+      commit();
+      return true;
+    }
+
+    /** Consumer: return a pointer to the oldest item, or nullptr if empty. */
+    T* front() {
+      uint8_t tail = __atomic_load_n(&mTail, __ATOMIC_RELAXED);
+      uint8_t head = __atomic_load_n(&mHead, __ATOMIC_ACQUIRE);
+      if (head == tail) return nullptr;
+      return &mItems[tail & (T_SIZE - 1)];
+    }
+
+    /** Consumer: release the item returned by front(). */
+    void pop() {
+      uint8_t tail = __atomic_load_n(&mTail, __ATOMIC_RELAXED);
+      __atomic_store_n(&mTail, (uint8_t) (tail + 1), __ATOMIC_RELEASE);
+    }
+
+    /** Consumer: copy the oldest item out. Returns false if empty. */
+    bool pop(T& item) {
+      T* slot = front();
+      if (! slot) return false;
+      item = *slot;
+      pop();
+      return true;
+    }
+
+    /** Return true if the ring is empty. Exact only on the consumer side. */
+    bool isEmpty() const {
+      return __atomic_load_n(&mHead, __ATOMIC_ACQUIRE)
+          == __atomic_load_n(&mTail, __ATOMIC_ACQUIRE);
+    }
+
+  private:
+    T mItems[T_SIZE];
+    uint8_t mHead = 0;
+    uint8_t mTail = 0;
+};
+
+}
+
+#endif
@@ -0,0 +1,231 @@
+/*
+MIT License
+
+Copyright (c) 2022 Brian T. Park
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef ACE_WIRE_SSD1306_STREAMER_H
+#define ACE_WIRE_SSD1306_STREAMER_H
+
+#include <stdint.h>
+#include "BulkTransfer.h"
+
+namespace ace_wire {
+
+/**
+ * Stream the changed parts of a framebuffer owned by the caller to an SSD1306
+ * OLED controller (or a compatible controller which supports the 0x21 column
+ * address and 0x22 page address commands) over any AceWire interface
+ * (`T_WIREI`).
+ *
+ * The framebuffer uses the native layout of the controller: `T_PAGES` pages of
+ * `T_WIDTH` bytes, where each byte holds 8 vertical pixels. The caller marks
+ * the regions that it has modified using markDirty(). This class keeps a
+ * single dirty column range for each page (2 bytes of RAM per page), and
+ * flush() sends only those ranges, setting the address window of the
+ * controller before each range.
+ *
+ * The flush() method accepts a byte budget, so that the transfer of a large
+ * update can be spread over several iterations of the global `loop()`. The
+ * partially transferred range is resumed by the next call to flush(). The
+ * pages are serviced in round-robin order, so that a page which is updated
+ * frequently does not starve the others.
+ *
+ * The data is sent using BulkTransfer, so the buffered interfaces (e.g.
+ * TwoWireInterface) work as long as `maxChunk` is set to the size of their TX
+ * buffer, which is the default from WireTraits.
+ *
+ * @tparam T_WIREI the AceWire interface class, e.g. SimpleWireInterface
+ * @tparam T_WIDTH number of columns of the display (default 128)
+ * @tparam T_PAGES number of 8-pixel pages of the display (default 8 for 64
+ *    rows, use 4 for 32 rows)
+ */
+template <typename T_WIREI, uint8_t T_WIDTH = 128, uint8_t T_PAGES = 8>
+class Ssd1306Streamer {
+  public:
+    /**
+     * Constructor.
+     *
+     * @param wireInterface instance of the AceWire interface
+     * @param addr I2C address of the controller, usually 0x3C or 0x3D
+     * @param frameBuffer framebuffer of `T_WIDTH * T_PAGES` bytes owned by the
+     *    caller
+     * @param maxChunk size of the TX buffer of `T_WIREI`, or 0 for unbuffered
+     *    interfaces (default WireTraits<T_WIREI>::kBufferSize, see
+     *    BulkTransfer)
+     */
+    explicit Ssd1306Streamer(
+        const T_WIREI& wireInterface,
+        uint8_t addr,
+        const uint8_t* frameBuffer,
+        uint16_t maxChunk = WireTraits<T_WIREI>::kBufferSize
+    ) :
+        mBulkTransfer(wireInterface, maxChunk),
+        mFrameBuffer(frameBuffer),
+        mAddr(addr)
+    {
+      clearDirty();
+    }
+
+    /**
+     * Mark the rectangle of pixels at (x, y) with width w and height h as
+     * modified. The rectangle is clipped to the display.
+     */
+    void markDirty(uint8_t x, uint8_t y, uint8_t w, uint8_t h) {
+      if (w == 0 || h == 0 || x >= T_WIDTH || y >= T_PAGES * 8) return;
+
+      uint8_t colEnd = (w > T_WIDTH - x) ? T_WIDTH - 1 : x + w - 1;
+      uint8_t rowEnd = (h > T_PAGES * 8 - y) ? T_PAGES * 8 - 1 : y + h - 1;
+      for (uint8_t page = y / 8; page <= rowEnd / 8; ++page) {
+        markPageDirty(page, x, colEnd);
+      }
+    }
+
+    /**
+     * Mark the columns from colStart to colEnd (inclusive) of the given page
+     * as modified.
+     */
+    void markPageDirty(uint8_t page, uint8_t colStart, uint8_t colEnd) {
+      if (page >= T_PAGES) return;
+      if (colEnd >= T_WIDTH) colEnd = T_WIDTH - 1;
+      if (colStart > colEnd) return;
+
+      if (colStart < mDirtyStart[page]) mDirtyStart[page] = colStart;
+      if (colEnd > mDirtyEnd[page] || mDirtyEnd[page] == kClean) {
+        mDirtyEnd[page] = colEnd;
+      }
+    }
+
+    /** Mark the entire display as modified. */
+    void markAllDirty() {
+      for (uint8_t page = 0; page < T_PAGES; ++page) {
+        mDirtyStart[page] = 0;
+        mDirtyEnd[page] = T_WIDTH - 1;
+      }
+    }
+
+    /** Return true if any part of the framebuffer still needs to be sent. */
+    bool isDirty() const {
+      for (uint8_t page = 0; page < T_PAGES; ++page) {
+        if (isPageDirty(page)) return true;
+      }
+      return false;
+    }
+
+    /**
+     * Send the modified regions of the framebuffer, up to `byteBudget` bytes
+     * of pixel data. Call isDirty() to determine if more calls are needed.
+     *
+     * @param byteBudget maximum number of pixel bytes to send in this call
+     *    (default: no limit)
+     * @return 0 upon success, otherwise the status code of BulkTransfer. The
+     *    region being sent remains dirty upon failure.
+     */
+    uint8_t flush(uint16_t byteBudget = 0xFFFF) {
+      for (uint8_t i = 0; i < T_PAGES && byteBudget; ++i) {
+        uint8_t page = mNextPage;
+        if (isPageDirty(page)) {
+          uint8_t colStart = mDirtyStart[page];
+          uint16_t n = mDirtyEnd[page] - colStart + 1;
+          if (n > byteBudget) n = byteBudget;
+
+          uint8_t status = sendRegion(page, colStart, n);
+          if (status) return status;
+          byteBudget -= n;
+
+          if (colStart + n <= mDirtyEnd[page]) {
+            // Budget exhausted in the middle of this page. Resume here.
+            mDirtyStart[page] = colStart + n;
+            return 0;
+          }
+          mDirtyStart[page] = kClean;
+          mDirtyEnd[page] = kClean;
+        }
+        mNextPage = (page + 1 >= T_PAGES) ? 0 : page + 1;
+      }
+      return 0;
+    }
+
+    // Use default copy constructor. Delete the assignment operator because it
+    // cannot work with constant fields.
+    Ssd1306Streamer(const Ssd1306Streamer&) = default;
+    Ssd1306Streamer& operator=(const Ssd1306Streamer&) = delete;
+
+  private:
+    /** Marker value for an empty dirty range. */
+    static const uint8_t kClean = 0xFF;
+
+    /** Control byte for a stream of commands. */
+    static const uint8_t kControlCommand = 0x00;
+
+    /** Control byte for a stream of display data. */
+    static const uint8_t kControlData = 0x40;
+
+    /** Command to set the column address window. */
+    static const uint8_t kSetColumnAddress = 0x21;
+
+    /** Command to set the page address window. */
+    static const uint8_t kSetPageAddress = 0x22;
+
+    bool isPageDirty(uint8_t page) const {
+      return mDirtyEnd[page] != kClean;
+    }
+
+    void clearDirty() {
+      for (uint8_t page = 0; page < T_PAGES; ++page) {
+        mDirtyStart[page] = kClean;
+        mDirtyEnd[page] = kClean;
+      }
+    }
+
+    /**
+     * Set the address window of the controller to the given columns of a
+     * single page, then send the pixel data. The controller must be in
+     * horizontal addressing mode (0x20, 0x00), which most drivers use.
+     */
+    uint8_t sendRegion(uint8_t page, uint8_t colStart, uint16_t n) {
+      const uint8_t commands[] = {
+        kSetColumnAddress, colStart, (uint8_t) (colStart + n - 1),
+        kSetPageAddress, page, page,
+      };
+      uint8_t control = kControlCommand;
+      uint8_t status = mBulkTransfer.write(
+          mAddr, &control, 1, commands, sizeof(commands));
+      if (status) return status;
+
+      control = kControlData;
+      return mBulkTransfer.write(
+          mAddr, &control, 1,
+          mFrameBuffer + (uint16_t) page * T_WIDTH + colStart, n);
+    }
+
+  private:
+    BulkTransfer<T_WIREI> const mBulkTransfer;
+    const uint8_t* const mFrameBuffer;
+    uint8_t const mAddr;
+    uint8_t mNextPage = 0;
+    uint8_t mDirtyStart[T_PAGES];
+    uint8_t mDirtyEnd[T_PAGES];
+};
+
+}
+
+#endif
@@ -26,6 +26,7 @@ SOFTWARE.
 #define ACE_WIRE_TESTATO_WIRE_INTERFACE_H
 
 #include <stdint.h>
+#include "GenericTransfer.h"
 
 namespace ace_wire {
 
@@ -38,8 +39,33 @@ namespace ace_wire {
  * `SoftwareWire`
  */
 template <typename T_WIRE>
-class TestatoWireInterface {
+class TestatoWireInterface :
+    public GenericTransfer<TestatoWireInterface<T_WIRE>> {
   public:
+    /**
+     * The `sendStop = false` parameter of endTransmission() and requestFrom()
+     * is honored, so the next transaction begins with a repeated START.
+     */
+    static const bool kSupportsRepeatedStart = true;
+
+    /** Data is sent to the bus immediately by write(). */
+    static const bool kBuffered = false;
+
+    /**
+     * Writes are not buffered, so a transaction has no limit. Only
+     * requestFrom() is limited by the RX buffer, see kMaxQuantity.
+     */
+    static const uint16_t kBufferSize = 0;
+
+    /** Maximum quantity of requestFrom(), limited by the RX buffer. */
+    static const uint16_t kMaxQuantity = 32;
+
+    /**
+     * The beginTransmission() method always returns 0. The NACK of the address
+     * is reported by endTransmission().
+     */
+    static const bool kReportsAddressNack = false;
+
     /**
      * Constructor.
      * @param wire instance of `SoftwareWire`
@@ -100,14 +126,16 @@ class TestatoWireInterface {
      * Prepare to read bytes from the device at the given address, and
      * send a STOP condition if `sendStop` is true. The underlying SoftwareWire
      * does not use a TX buffer, so the addr is immediately placed on the I2C
-     * bus.
+     * bus. The `quantity` must be at most 255.
      *
      * @return `quantity` if the device responded with an ACK, or 0 if the
      * device responded with a NACK.
      */
-    uint8_t requestFrom(uint8_t addr, uint8_t quantity, bool sendStop = true)
-        const {
-      return mWire.requestFrom(addr, quantity, sendStop);
+    uint16_t requestFrom(
+        uint8_t addr, uint16_t quantity, bool sendStop = true) const {
+      // The underlying library supports only an 8-bit quantity.
+      if (quantity > 255) return 0;
+      return mWire.requestFrom(addr, (uint8_t) quantity, sendStop);
     }
 
     /** Read byte from buffer. */
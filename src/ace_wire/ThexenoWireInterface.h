@@ -26,6 +26,7 @@ SOFTWARE.
 #define ACE_WIRE_THEXENO_WIRE_INTERFACE_H
 
 #include <stdint.h>
+#include "GenericTransfer.h"
 
 namespace ace_wire {
 
@@ -38,8 +39,30 @@ namespace ace_wire {
  * @tparam T_WIRE underlying I2C class which will always be `TwoWire`
  */
 template <typename T_WIRE>
-class ThexenoWireInterface {
+class ThexenoWireInterface :
+    public GenericTransfer<ThexenoWireInterface<T_WIRE>> {
   public:
+    /**
+     * The `sendStop = false` parameter of endTransmission() and requestFrom()
+     * is honored, so the next transaction begins with a repeated START.
+     */
+    static const bool kSupportsRepeatedStart = true;
+
+    /** Data is buffered, and sent to the bus by endTransmission(). */
+    static const bool kBuffered = true;
+
+    /** Size of the TX and RX buffers. */
+    static const uint16_t kBufferSize = 32;
+
+    /** Maximum quantity of requestFrom(), limited by the RX buffer. */
+    static const uint16_t kMaxQuantity = 32;
+
+    /**
+     * The beginTransmission() method always returns 0. The NACK of the address
+     * is reported by endTransmission().
+     */
+    static const bool kReportsAddressNack = false;
+
     /**
      * Constructor.
      * @param wire instance of `HardWire`
@@ -95,15 +118,17 @@ class ThexenoWireInterface {
      * send a STOP condition if `sendStop` is true.
      *
      * @param addr I2C address
-     * @param quantity number of bytes to read
+     * @param quantity number of bytes to read, at most 255
      * @param sendStop whether the STOP condition should be sent at end
      *
      * @return the value returned by the underlying T_WIRE::requestFrom()
      * method, which will normally be 'quantity'
      */
-    uint8_t requestFrom(uint8_t addr, uint8_t quantity, bool sendStop = true)
-        const {
-      return mWire.requestFrom(addr, quantity, (uint8_t) sendStop);
+    uint16_t requestFrom(
+        uint8_t addr, uint16_t quantity, bool sendStop = true) const {
+      // The underlying library supports only an 8-bit quantity.
+      if (quantity > 255) return 0;
+      return mWire.requestFrom(addr, (uint8_t) quantity, (uint8_t) sendStop);
     }
 
     /** Read byte from the TwoWire receive buffer. */
@@ -26,6 +26,7 @@ SOFTWARE.
 #define ACE_WIRE_TODBOT_WIRE_INTERFACE_H
 
 #include <stdint.h>
+#include "GenericTransfer.h"
 
 namespace ace_wire {
 
@@ -38,11 +39,37 @@ namespace ace_wire {
  * https://github.com/felias-fogg/SoftI2CMaster project, so the two cannot be
  * activated at the same time.
  *
+ * The SoftI2CMaster class always sends a STOP in endTransmission(), but its
+ * START condition raises both lines before pulling SDA LOW, so it generates a
+ * valid repeated START if the STOP is skipped. This class takes advantage of
+ * that to honor `sendStop = false`. It also tracks the `quantity` of
+ * requestFrom(), so that the last byte is read with `readLast()` (which sends
+ * the NACK), followed by the STOP condition if requested.
+ *
  * @tparam T_WIRE underlying class which will be SoftI2CMaster
  */
 template <typename T_WIRE>
-class TodbotWireInterface {
+class TodbotWireInterface :
+    public GenericTransfer<TodbotWireInterface<T_WIRE>> {
   public:
+    /**
+     * The `sendStop = false` parameter of endTransmission() and requestFrom()
+     * is honored, so the next transaction begins with a repeated START.
+     */
+    static const bool kSupportsRepeatedStart = true;
+
+    /** Data is sent to the bus immediately by write(). */
+    static const bool kBuffered = false;
+
+    /** No buffer, so the size of a transaction is not limited. */
+    static const uint16_t kBufferSize = 0;
+
+    /** Maximum quantity of requestFrom(), limited by its 8-bit type. */
+    static const uint16_t kMaxQuantity = 255;
+
+    /** The beginTransmission() method reports the NACK of the address. */
+    static const bool kReportsAddressNack = true;
+
     /**
      * Constructor.
      * @param wire instance of `SoftI2CMaster`
@@ -85,14 +112,15 @@ class TodbotWireInterface {
     }
 
     /**
-     * Send the data in the buffer. The sendStop parameter is ignored by the
-     * SoftI2CMaster class and the underlying implementation always
-     * sends the STOP condition.
+     * Send the STOP condition if `sendStop` is true. Otherwise, do nothing, so
+     * that the next beginTransmission() or requestFrom() generates a repeated
+     * START.
      *
-     * Returns the status value of the original beginTransmission().
+     * Returns the status value of the original beginTransmission(), or 0 if
+     * `sendStop` is false.
      */
     uint8_t endTransmission(bool sendStop = true) const {
-      (void) sendStop;
+      if (! sendStop) return 0;
       return mWire.endTransmission();
     }
 
@@ -101,19 +129,21 @@ class TodbotWireInterface {
      * not implement at TX buffer, so the addr is sent immediately on the bus.
      *
      * @param addr I2C address
-     * @param quantity number of bytes to read
-     * @param sendStop whether to send a STOP condition after reading. This
-     * parameter is ignored by the SoftI2CMaster implementation which *never*
-     * sends a STOP condition
+     * @param quantity number of bytes to read, at most 255
+     * @param sendStop whether to send a STOP condition after reading the last
+     * byte in read()
      *
-     * @return the value returned by the underlying SoftI2CMaster::requestFrom()
-     * method, which is 0 for success if the device responded with an ACK, and 1
-     * if the device sent a NACK
+     * @return `quantity` if the device responded with an ACK, 0 if the device
+     * sent a NACK. The underlying SoftI2CMaster::requestFrom() method returns
+     * 1 upon ACK and 0 upon NACK, like its beginTransmission().
      */
-    uint8_t requestFrom(uint8_t addr, uint8_t quantity, bool sendStop = true)
-        const {
-      (void) sendStop; // sendStop not implemented by SoftI2CMaster
-      return mWire.requestFrom(addr, quantity);
+    uint16_t requestFrom(
+        uint8_t addr, uint16_t quantity, bool sendStop = true) const {
+      // The underlying library supports only an 8-bit quantity.
+      if (quantity > 255) return 0;
+      mQuantity = quantity;
+      mSendStop = sendStop;
+      return mWire.requestFrom(addr, (uint8_t) quantity) ? quantity : 0;
     }
 
     /**
@@ -121,17 +151,26 @@ class TodbotWireInterface {
      * different `read()` methods:
      *
      *  * `read()` for all bytes except the last one (which sends an ACK from
-     *  the master to device), exposed by this method
+     *  the master to device)
      *  * `readLast()` to read the last byte (which sends a NACK from master to
-     *  device), not exposed by this wrapper class
+     *  device)
+     *
+     * This method merges the two, using the `quantity` given to requestFrom().
+     * A STOP condition is sent after the last byte if requestFrom() was called
+     * with `sendStop = true`.
      *
-     * It is probably possible for this adapter class to merge the two read()
-     * methods, and generate the required STOP condition, so that it becomes
-     * consistent with other I2C libraries. But I don't want to spend the effort
-     * to do that because I don't use the SoftI2CMaster library.
+     * If called when the number of remaining bytes is 0, this method returns
+     * immediately with a 0xff.
      */
     uint8_t read() const {
-      return mWire.read();
+      if (! mQuantity) return 0xff;
+
+      mQuantity--;
+      if (mQuantity) return mWire.read();
+
+      uint8_t data = mWire.readLast();
+      if (mSendStop) mWire.endTransmission();
+      return data;
     }
 
     // Use default copy constructor and assignment operator.
@@ -140,6 +179,8 @@ class TodbotWireInterface {
 
   private:
     T_WIRE& mWire;
+    mutable uint16_t mQuantity = 0;
+    mutable bool mSendStop = true;
 };
 
 }
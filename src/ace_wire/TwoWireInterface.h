@@ -26,6 +26,21 @@ SOFTWARE.
 #define ACE_WIRE_TWO_WIRE_INTERFACE_H
 
 #include <stdint.h>
+#include "SpeedProfile.h"
+#include "GenericTransfer.h"
+
+// Size of the TX and RX buffers of the TwoWire class of the platform, reported
+// by TwoWireInterface::kBufferSize. Can be overridden by defining this macro
+// before including this file.
+#if ! defined(ACE_WIRE_TWO_WIRE_BUFFER_SIZE)
+  #if defined(ESP8266) || defined(ESP32)
+    #define ACE_WIRE_TWO_WIRE_BUFFER_SIZE 128
+  #elif defined(ARDUINO_ARCH_SAMD)
+    #define ACE_WIRE_TWO_WIRE_BUFFER_SIZE 256
+  #else
+    #define ACE_WIRE_TWO_WIRE_BUFFER_SIZE 32
+  #endif
+#endif
 
 namespace ace_wire {
 
@@ -43,17 +58,52 @@ namespace ace_wire {
  * increases flash memory on AVR by about 1000 byte even if the `Wire` object is
  * never used.
  *
+ * If a custom `T_PROFILE` is given, the clock speed of the bus is switched by
+ * beginTransmission() and requestFrom() according to the address of the
+ * device, normally by a ClockSelector which calls `T_WIRE::setClock()` only
+ * when the speed changes. The default NoClockProfile compiles to nothing.
+ *
  * @tparam T_WIRE underlying class that implements the I2C protocol which will
  *    always be `TwoWire`
+ * @tparam T_PROFILE compile-time clock profile, a class with a static
+ *    `selectClock(T_WIRE&, uint8_t addr)` method (default NoClockProfile)
  */
-template <typename T_WIRE>
-class TwoWireInterface {
+template <typename T_WIRE, typename T_PROFILE = NoClockProfile>
+class TwoWireInterface :
+    public GenericTransfer<TwoWireInterface<T_WIRE, T_PROFILE>> {
   public:
+    /**
+     * The `sendStop = false` parameter of endTransmission() and requestFrom()
+     * is honored, so the next transaction begins with a repeated START.
+     */
+    static const bool kSupportsRepeatedStart = true;
+
+    /** Data is buffered, and sent to the bus by endTransmission(). */
+    static const bool kBuffered = true;
+
+    /** Size of the TX and RX buffers. */
+    static const uint16_t kBufferSize = ACE_WIRE_TWO_WIRE_BUFFER_SIZE;
+
+    /**
+     * Maximum quantity of requestFrom(), limited by the RX buffer and the
+     * 8-bit quantity of the underlying library.
+     */
+    static const uint16_t kMaxQuantity =
+        (kBufferSize < 255) ? kBufferSize : 255;
+
+    /**
+     * The beginTransmission() method always returns 0. The NACK of the address
+     * is reported by endTransmission().
+     */
+    static const bool kReportsAddressNack = false;
+
     /**
      * Constructor.
      * @param wire instance of `TwoWire` which will always be the `Wire` object
      */
-    explicit TwoWireInterface(T_WIRE& wire) : mWire(wire) {}
+    explicit TwoWireInterface(T_WIRE& wire) :
+        mWire(wire)
+    {}
 
     /** Initialize the interface. Currently does nothing. */
     void begin() const {}
@@ -69,6 +119,7 @@ class TwoWireInterface {
      *    written into a buffer
      */
     uint8_t beginTransmission(uint8_t addr) const {
+      T_PROFILE::selectClock(mWire, addr);
       mWire.beginTransmission(addr);
       return 0;
     }
@@ -104,15 +155,18 @@ class TwoWireInterface {
      * send a STOP condition if `sendStop` is true.
      *
      * @param addr I2C address
-     * @param quantity number of bytes to read
+     * @param quantity number of bytes to read, at most 255
      * @param sendStop whether the STOP condition should be sent at end
      *
      * @return the value returned by the underlying T_WIRE::requestFrom()
      * method, which will normally be 'quantity'
      */
-    uint8_t requestFrom(uint8_t addr, uint8_t quantity, bool sendStop = true)
-        const {
-      return mWire.requestFrom(addr, quantity, (uint8_t) sendStop);
+    uint16_t requestFrom(
+        uint8_t addr, uint16_t quantity, bool sendStop = true) const {
+      // The underlying library supports only an 8-bit quantity.
+      if (quantity > 255) return 0;
+      T_PROFILE::selectClock(mWire, addr);
+      return mWire.requestFrom(addr, (uint8_t) quantity, (uint8_t) sendStop);
     }
 
     /** Read byte from the TwoWire receive buffer. */
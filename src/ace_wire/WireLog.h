@@ -0,0 +1,371 @@
+/*
+MIT License
+
+Copyright (c) 2022 Brian T. Park
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+
+#ifndef ACE_WIRE_WIRE_LOG_H
+#define ACE_WIRE_WIRE_LOG_H
+
+#include <stdint.h>
+#include <Arduino.h> // micros()
+
+namespace ace_wire {
+
+/** A single call on an AceWire interface, stored in a WireLog. */
+struct WireLogRecord {
+  /** The method, one of the WireLog::kOpXxx constants. */
+  uint8_t op;
+
+  /**
+   * I2C address of beginTransmission(), requestFrom() and readInto(), or of
+   * the first message of transfer().
+   */
+  uint8_t addr;
+
+  /**
+   * Data byte of write() and read(), or the `index` of the TransferResult of
+   * transfer().
+   */
+  uint8_t data;
+
+  /** The `sendStop` of endTransmission(), requestFrom() and readInto(). */
+  bool sendStop;
+
+  /**
+   * Return value of beginTransmission(), write() and endTransmission(). For
+   * requestFrom(), 1 if it returned non-zero, 0 if it returned 0. For
+   * readInto(), 1 if at least one byte was received. For transfer(), the
+   * `status` of the TransferResult.
+   */
+  uint8_t result;
+
+  /**
+   * The `quantity` of requestFrom() and readInto(), or the number of messages
+   * of transfer().
+   */
+  uint16_t quantity;
+
+  /** The return value of requestFrom(), the number of bytes received. */
+  uint16_t received;
+
+  /** Time since the previous record, in microseconds. */
+  uint32_t deltaMicros;
+};
+
+/** Summary of the transactions in a WireLog. */
+struct WireLogSummary {
+  /** Number of START conditions, including repeated STARTs. */
+  uint32_t starts;
+
+  /** Number of bytes sent by write(), excluding the addresses. */
+  uint32_t bytesWritten;
+
+  /** Number of bytes received by read(). */
+  uint32_t bytesRead;
+
+  /** Number of calls which failed (NACK or a non-zero status). */
+  uint32_t failures;
+
+  /** Time from the first to the last record, in microseconds. */
+  uint32_t durationMicros;
+};
+
+/**
+ * A compact binary log of the calls on an AceWire interface, stored in a
+ * buffer owned by the caller. It is written by RecordingWireInterface, and
+ * read back by ReplayWireInterface. On Linux (e.g. under EpoxyDuino), the
+ * buffer can simply be saved to and loaded from a file, so that a trace
+ * captured on the device can be replayed on the host.
+ *
+ * Each record is 2-5 bytes for most calls:
+ *
+ *  * 1 byte: the op in bits 0-2, `sendStop` in bit 3, `result` in bits 4-7
+ *  * 1-5 bytes: the time since the previous record, as an unsigned LEB128
+ *  * 1 byte: the address (kOpBeginTransmission, kOpRequestFrom, kOpTransfer,
+ *    kOpReadInto), or the data byte (kOpWrite, kOpRead)
+ *  * 1 byte: the index of the TransferResult (kOpTransfer only)
+ *  * 1-3 bytes: the quantity as an unsigned LEB128 (kOpRequestFrom,
+ *    kOpReadInto), or the number of messages (kOpTransfer)
+ *  * 1-3 bytes: the number of bytes received as an unsigned LEB128
+ *    (kOpRequestFrom only)
+ *
+ * A transfer() is followed by a kOpWrite or kOpRead record for each byte of
+ * the messages which completed, and a readInto() by a kOpRead record for each
+ * byte passed to the sink, so that ReplayWireInterface can serve the data.
+ *
+ * If a record does not fit, it is dropped and isOverflow() becomes true.
+ *
+ * The log also holds the replay position of ReplayWireInterface, which is
+ * shared by all copies of the interface.
+ */
+class WireLog {
+  public:
+    static const uint8_t kOpBeginTransmission = 1;
+    static const uint8_t kOpWrite = 2;
+    static const uint8_t kOpEndTransmission = 3;
+    static const uint8_t kOpRequestFrom = 4;
+    static const uint8_t kOpRead = 5;
+    static const uint8_t kOpTransfer = 6;
+    static const uint8_t kOpReadInto = 7;
+
+    /**
+     * Constructor.
+     *
+     * @param buf buffer owned by the caller
+     * @param capacity size of buf
+     * @param size number of bytes of a previously recorded log in buf, for
+     *    replaying (default 0)
+     */
+    explicit WireLog(uint8_t* buf, uint32_t capacity, uint32_t size = 0) :
+        mBuf(buf),
+        mCapacity(capacity),
+        mSize(size <= capacity ? size : capacity)
+    {}
+
+    /** Discard all records, and rewind the replay position. */
+    void clear() {
+      mSize = 0;
+      mOverflow = false;
+      mStarted = false;
+      rewind();
+    }
+
+    /** Return the encoded records. */
+    const uint8_t* data() const { return mBuf; }
+
+    /** Return the number of bytes used by the records. */
+    uint32_t size() const { return mSize; }
+
+    /** Return true if a record was dropped because the buffer was full. */
+    bool isOverflow() const { return mOverflow; }
+
+    /**
+     * Append `record`, setting its `deltaMicros` from the time of the
+     * previous record.
+     *
+     * @return true upon success, false if the buffer is full
+     */
+    bool append(WireLogRecord& record) {
+      uint32_t now = micros();
+      record.deltaMicros = mStarted ? now - mLastMicros : 0;
+      mStarted = true;
+      mLastMicros = now;
+
+      uint8_t encoded[13];
+      uint8_t n = 0;
+      encoded[n++] = (record.op & 0x07)
+          | (record.sendStop ? 0x08 : 0)
+          | (uint8_t) (record.result << 4);
+      n = putVarint(encoded, n, record.deltaMicros);
+      if (record.op == kOpWrite || record.op == kOpRead) {
+        encoded[n++] = record.data;
+      } else if (record.op != kOpEndTransmission) {
+        encoded[n++] = record.addr;
+      }
+      if (record.op == kOpTransfer) encoded[n++] = record.data;
+      if (record.op >= kOpRequestFrom && record.op != kOpRead) {
+        n = putVarint(encoded, n, record.quantity);
+      }
+      if (record.op == kOpRequestFrom) {
+        n = putVarint(encoded, n, record.received);
+      }
+
+      if (n > mCapacity - mSize) {
+        mOverflow = true;
+        return false;
+      }
+      for (uint8_t i = 0; i < n; ++i) mBuf[mSize++] = encoded[i];
+      return true;
+    }
+
+    /**
+     * Replace the result of the record at `pos`, whose outcome was not known
+     * when it was appended (e.g. kOpReadInto, which precedes the records of
+     * its bytes).
+     */
+    void setResult(uint32_t pos, uint8_t result) {
+      if (pos < mSize) {
+        mBuf[pos] = (mBuf[pos] & 0x0F) | (uint8_t) (result << 4);
+      }
+    }
+
+    /**
+     * Decode the record at `pos`, and advance `pos` to the next record.
+     *
+     * @return true upon success, false at the end of the log, or if the
+     *    record is truncated
+     */
+    bool decode(uint32_t& pos, WireLogRecord& record) const {
+      if (pos >= mSize) return false;
+      uint32_t p = pos;
+      uint8_t header = mBuf[p++];
+      record.op = header & 0x07;
+      record.sendStop = (header & 0x08) != 0;
+      record.result = header >> 4;
+      record.addr = 0;
+      record.data = 0;
+      record.quantity = 0;
+      record.received = 0;
+      if (! getVarint(p, record.deltaMicros)) return false;
+
+      if (record.op != kOpEndTransmission) {
+        if (p >= mSize) return false;
+        uint8_t value = mBuf[p++];
+        if (record.op == kOpWrite || record.op == kOpRead) {
+          record.data = value;
+        } else {
+          record.addr = value;
+        }
+      }
+      if (record.op == kOpTransfer) {
+        if (p >= mSize) return false;
+        record.data = mBuf[p++];
+      }
+      if (record.op >= kOpRequestFrom && record.op != kOpRead) {
+        uint32_t quantity;
+        if (! getVarint(p, quantity)) return false;
+        record.quantity = (uint16_t) quantity;
+      }
+      if (record.op == kOpRequestFrom) {
+        uint32_t received;
+        if (! getVarint(p, received)) return false;
+        record.received = (uint16_t) received;
+      }
+      pos = p;
+      return true;
+    }
+
+    /** Count the transactions, bytes and failures of the whole log. */
+    WireLogSummary summarize() const {
+      WireLogSummary summary = {0, 0, 0, 0, 0};
+      WireLogRecord record;
+      bool first = true;
+      for (uint32_t pos = 0; decode(pos, record); ) {
+        if (! first) summary.durationMicros += record.deltaMicros;
+        first = false;
+        switch (record.op) {
+          case kOpBeginTransmission:
+            summary.starts++;
+            if (record.result) summary.failures++;
+            break;
+          case kOpWrite:
+            summary.bytesWritten++;
+            if (! record.result) summary.failures++;
+            break;
+          case kOpEndTransmission:
+            if (record.result) summary.failures++;
+            break;
+          case kOpRequestFrom:
+            summary.starts++;
+            if (! record.result) summary.failures++;
+            break;
+          case kOpRead:
+            summary.bytesRead++;
+            break;
+          case kOpTransfer:
+            // The messages up to the failed one, each with its own START.
+            summary.starts += (record.data < record.quantity)
+                ? record.data + 1 : record.quantity;
+            if (record.result) summary.failures++;
+            break;
+          case kOpReadInto:
+            summary.starts++;
+            if (! record.result) summary.failures++;
+            break;
+        }
+      }
+      return summary;
+    }
+
+    /** Move the replay position back to the first record. */
+    void rewind() {
+      mReplayPos = 0;
+      mMismatches = 0;
+      mSkipped = 0;
+    }
+
+    /** Return the replay position, as an offset into data(). */
+    uint32_t replayPosition() const { return mReplayPos; }
+
+    /** Set the replay position (used by ReplayWireInterface). */
+    void setReplayPosition(uint32_t pos) { mReplayPos = pos; }
+
+    /**
+     * Return the number of replayed calls which did not match the next
+     * record.
+     */
+    uint16_t mismatches() const { return mMismatches; }
+
+    /** Return the number of records skipped by the replay. */
+    uint16_t skipped() const { return mSkipped; }
+
+    /** Count a mismatched call (used by ReplayWireInterface). */
+    void addMismatch() { mMismatches++; }
+
+    /** Count skipped records (used by ReplayWireInterface). */
+    void addSkipped(uint16_t n) { mSkipped += n; }
+
+    // Delete the copy constructor and assignment operator because this object
+    // is shared by all copies of the recording or replaying interface.
+    WireLog(const WireLog&) = delete;
+    WireLog& operator=(const WireLog&) = delete;
+
+  private:
+    /** Append `value` to `buf` at `n` as an unsigned LEB128. */
+    static uint8_t putVarint(uint8_t* buf, uint8_t n, uint32_t value) {
+      while (value >= 0x80) {
+        buf[n++] = (uint8_t) (value | 0x80);
+        value >>= 7;
+      }
+      buf[n++] = (uint8_t) value;
+      return n;
+    }
+
+    /** Decode an unsigned LEB128 at `p`. */
+    bool getVarint(uint32_t& p, uint32_t& value) const {
+      value = 0;
+      for (uint8_t shift = 0; shift < 35; shift += 7) {
+        if (p >= mSize) return false;
+        uint8_t b = mBuf[p++];
+        value |= (uint32_t) (b & 0x7F) << shift;
+        if (! (b & 0x80)) return true;
+      }
+      return false;
+    }
+
+  private:
+    uint8_t* const mBuf;
+    uint32_t const mCapacity;
+    uint32_t mSize;
+    bool mOverflow = false;
+    bool mStarted = false;
+    uint32_t mLastMicros = 0;
+
+    uint32_t mReplayPos = 0;
+    uint16_t mMismatches = 0;
+    uint16_t mSkipped = 0;
+};
+
+}
+
+#endif
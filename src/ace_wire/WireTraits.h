@@ -0,0 +1,103 @@
+/*
+MIT License
+
+Copyright (c) 2022 Brian T. Park
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef ACE_WIRE_WIRE_TRAITS_H
+#define ACE_WIRE_WIRE_TRAITS_H
+
+#include <stdint.h>
+
+namespace ace_wire {
+
+/**
+ * Compile-time capabilities of an AceWire interface class `T_WIREI`, so that
+ * generic code can select the optimal path without runtime branches. For
+ * example, chunking can be skipped for unbuffered interfaces, and the address
+ * NACK can be checked right after beginTransmission() only if it is reported
+ * there.
+ *
+ * The values are taken from the static constants of `T_WIREI`, which are
+ * defined by all interface classes in this library. A custom interface class
+ * can either define the same constants, or specialize this template.
+ *
+ * @tparam T_WIREI the AceWire interface class, e.g. SimpleWireInterface
+ */
+template <typename T_WIREI>
+struct WireTraits {
+  /**
+   * True if write() stores the data in a buffer which is sent by
+   * endTransmission(), false if write() sends the data immediately.
+   */
+  static const bool kBuffered = T_WIREI::kBuffered;
+
+  /**
+   * Maximum number of data bytes in a single transaction, limited by the
+   * TX or RX buffer, or 0 if there is no limit.
+   */
+  static const uint16_t kBufferSize = T_WIREI::kBufferSize;
+
+  /** Maximum `quantity` of a single requestFrom(). */
+  static const uint16_t kMaxQuantity = T_WIREI::kMaxQuantity;
+
+  /**
+   * True if `sendStop = false` is honored by both endTransmission() and
+   * requestFrom().
+   */
+  static const bool kSupportsRepeatedStart = T_WIREI::kSupportsRepeatedStart;
+
+  /**
+   * True if beginTransmission() returns 1 for a NACK of the address, false
+   * if it always returns 0 and the NACK is reported by endTransmission().
+   */
+  static const bool kReportsAddressNack = T_WIREI::kReportsAddressNack;
+};
+
+/**
+ * Release the bus after a requestFrom() with `sendStop = false` which will
+ * not be continued, either because it failed or because the caller stopped
+ * reading. Interfaces have no method which sends only the STOP condition, so
+ * the cost depends on the interface:
+ *
+ *  * If repeated START is not supported, the requestFrom() has already sent
+ *    the STOP condition, so nothing is sent.
+ *  * If the interface is unbuffered (e.g. SimpleWireInterface), its
+ *    endTransmission() sends just the STOP condition.
+ *  * If the interface is buffered (e.g. TwoWireInterface), its
+ *    endTransmission() would write to the address of the last
+ *    beginTransmission(), which may be a different device. Instead, an empty
+ *    write is sent to `addr`, which costs one address byte. Most devices
+ *    ignore it, but it resets the register pointer of some.
+ *
+ * @param wireInterface the AceWire interface
+ * @param addr I2C address of the device of the requestFrom()
+ */
+template <typename T_WIREI>
+void endRead(const T_WIREI& wireInterface, uint8_t addr) {
+  if (! WireTraits<T_WIREI>::kSupportsRepeatedStart) return;
+  if (WireTraits<T_WIREI>::kBuffered) wireInterface.beginTransmission(addr);
+  wireInterface.endTransmission();
+}
+
+}
+
+#endif
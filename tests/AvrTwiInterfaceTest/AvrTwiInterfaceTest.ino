@@ -0,0 +1,287 @@
+#line 2 "AvrTwiInterfaceTest.ino"
+
+#include <AUnit.h>
+#include <AceWire.h>
+
+using aunit::TestRunner;
+using namespace ace_wire;
+
+//-----------------------------------------------------------------------------
+// A simulated TWI peripheral, used as the T_REGS parameter of AvrTwiMaster. An
+// action started by writing TWINT=1 into TWCR completes immediately, setting
+// TWINT and the status in TWSR, unless the bus is stuck. A single device at
+// kDeviceAddr ACKs up to kDeviceSize written bytes, and returns 1, 2, 3, ...
+// when read.
+//-----------------------------------------------------------------------------
+
+const uint8_t kDeviceAddr = 0x68;
+const uint8_t kDeviceSize = 4;
+
+const uint8_t kTwint = 0x80;
+const uint8_t kTwea = 0x40;
+const uint8_t kTwsta = 0x20;
+const uint8_t kTwsto = 0x10;
+const uint8_t kTwie = 0x01;
+
+enum class BusState : uint8_t { kIdle, kAddress, kWrite, kRead };
+
+struct SimTwi {
+  static uint8_t twcr;
+  static uint8_t twsr;
+  static uint8_t twdr;
+  static BusState state;
+  static bool stuck;
+  static uint8_t numStarts;
+  static uint8_t numStops;
+  static uint8_t numWritten;
+  static uint8_t written[kDeviceSize];
+  static uint8_t nextRead;
+
+  static void reset() {
+    twcr = twsr = twdr = 0;
+    state = BusState::kIdle;
+    stuck = false;
+    numStarts = numStops = numWritten = 0;
+    nextRead = 1;
+  }
+
+  static uint8_t readTwcr() { return twcr; }
+  static uint8_t readTwsr() { return twsr; }
+  static void writeTwsr(uint8_t value) { twsr = value; }
+  static uint8_t readTwdr() { return twdr; }
+  static void writeTwdr(uint8_t value) { twdr = value; }
+  static void writeTwbr(uint8_t /*value*/) {}
+
+  static void writeTwcr(uint8_t value) {
+    twcr = value & ~kTwint;
+    if (! (value & kTwint) || stuck) return;
+
+    if (value & kTwsto) {
+      // The STOP condition does not set TWINT, and clears TWSTO when sent.
+      numStops++;
+      state = BusState::kIdle;
+      twcr &= ~kTwsto;
+      return;
+    }
+
+    if (value & kTwsta) {
+      numStarts++;
+      twsr = (state == BusState::kIdle) ? 0x08 : 0x10;
+      state = BusState::kAddress;
+    } else if (state == BusState::kAddress) {
+      bool read = twdr & 0x01;
+      bool ack = (twdr >> 1) == kDeviceAddr;
+      twsr = read ? (ack ? 0x40 : 0x48) : (ack ? 0x18 : 0x20);
+      state = read ? BusState::kRead : BusState::kWrite;
+    } else if (state == BusState::kWrite) {
+      bool ack = numWritten < kDeviceSize;
+      if (ack) written[numWritten++] = twdr;
+      twsr = ack ? 0x28 : 0x30;
+    } else if (state == BusState::kRead) {
+      twdr = nextRead++;
+      twsr = (value & kTwea) ? 0x50 : 0x58;
+    }
+    twcr |= kTwint;
+  }
+};
+
+uint8_t SimTwi::twcr;
+uint8_t SimTwi::twsr;
+uint8_t SimTwi::twdr;
+BusState SimTwi::state;
+bool SimTwi::stuck;
+uint8_t SimTwi::numStarts;
+uint8_t SimTwi::numStops;
+uint8_t SimTwi::numWritten;
+uint8_t SimTwi::written[kDeviceSize];
+uint8_t SimTwi::nextRead;
+
+using Master = AvrTwiMaster<SimTwi>;
+Master twiMaster;
+AvrTwiInterface<Master> wireInterface(
+    twiMaster, 16000000, 100000, 10 /*transferTimeoutMillis*/);
+
+// Emulate the TWI interrupt, which is not available on the host.
+void runInterrupts() {
+  while (twiMaster.isBusy() && (SimTwi::twcr & kTwint)) {
+    twiMaster.handleInterrupt();
+  }
+}
+
+//-----------------------------------------------------------------------------
+// Polled mode.
+//-----------------------------------------------------------------------------
+
+test(AvrTwiInterfaceTest, polledWrite) {
+  SimTwi::reset();
+  assertEqual(0, wireInterface.beginTransmission(kDeviceAddr));
+  assertEqual(1, wireInterface.write(0x11));
+  assertEqual(1, wireInterface.write(0x22));
+  assertEqual(0, wireInterface.endTransmission());
+
+  assertEqual(1, SimTwi::numStarts);
+  assertEqual(1, SimTwi::numStops);
+  assertEqual(2, SimTwi::numWritten);
+  assertEqual(0x11, SimTwi::written[0]);
+  assertEqual(0x22, SimTwi::written[1]);
+}
+
+test(AvrTwiInterfaceTest, polledRead) {
+  SimTwi::reset();
+  assertEqual(3, wireInterface.requestFrom(kDeviceAddr, 3));
+  assertEqual(1, wireInterface.read());
+  assertEqual(2, wireInterface.read());
+  assertEqual(0, SimTwi::numStops);
+  assertEqual(3, wireInterface.read());
+
+  // The last byte is NACKed, followed by the STOP condition.
+  assertEqual(0x58, SimTwi::twsr);
+  assertEqual(1, SimTwi::numStops);
+  assertEqual(0xff, wireInterface.read());
+}
+
+test(AvrTwiInterfaceTest, polledAddressNack) {
+  SimTwi::reset();
+  assertEqual(1, wireInterface.beginTransmission(0x50));
+  wireInterface.endTransmission();
+  assertEqual(0, wireInterface.requestFrom(0x50, 2));
+  assertEqual(2, SimTwi::numStops);
+  assertEqual(0xff, wireInterface.read());
+}
+
+test(AvrTwiInterfaceTest, polledDataNack) {
+  SimTwi::reset();
+  assertEqual(0, wireInterface.beginTransmission(kDeviceAddr));
+  for (uint8_t i = 0; i < kDeviceSize; ++i) {
+    assertEqual(1, wireInterface.write(i));
+  }
+  assertEqual(0, wireInterface.write(0xAA));
+  wireInterface.endTransmission();
+}
+
+test(AvrTwiInterfaceTest, polledStuckBus) {
+  SimTwi::reset();
+  SimTwi::stuck = true;
+  // The polls of TWINT are bounded by kMaxPolls.
+  assertEqual(1, wireInterface.beginTransmission(kDeviceAddr));
+}
+
+test(AvrTwiInterfaceTest, readInto) {
+  SimTwi::reset();
+  uint8_t count = 0;
+  uint32_t n = wireInterface.readInto(kDeviceAddr, 0, [&](uint8_t data) {
+    count++;
+    return data < 2;
+  });
+
+  // The TWI decides the ACK before the byte arrives, so one more byte is
+  // received and discarded.
+  assertEqual((uint32_t) 2, n);
+  assertEqual(2, count);
+  assertEqual(4, SimTwi::nextRead);
+  assertEqual(1, SimTwi::numStops);
+}
+
+//-----------------------------------------------------------------------------
+// Interrupt-driven mode.
+//-----------------------------------------------------------------------------
+
+test(AvrTwiInterfaceTest, startTransfer) {
+  SimTwi::reset();
+  uint8_t reg = 0x42;
+  uint8_t data[3] = {0, 0, 0};
+  Message msgs[] = {
+    {kDeviceAddr, 0, 1, &reg},
+    {kDeviceAddr, Message::kRead, sizeof(data), data},
+  };
+
+  assertTrue(twiMaster.startTransfer(msgs, 2));
+  assertTrue(twiMaster.isBusy());
+  assertFalse(twiMaster.startTransfer(msgs, 2));
+  runInterrupts();
+
+  assertFalse(twiMaster.isBusy());
+  assertEqual(0, twiMaster.result().status);
+  assertEqual(2, twiMaster.result().index);
+  assertEqual(0x42, SimTwi::written[0]);
+  assertEqual(1, data[0]);
+  assertEqual(2, data[1]);
+  assertEqual(3, data[2]);
+
+  // The 2 segments are joined with a repeated START.
+  assertEqual(2, SimTwi::numStarts);
+  assertEqual(1, SimTwi::numStops);
+}
+
+test(AvrTwiInterfaceTest, startTransferAddressNack) {
+  SimTwi::reset();
+  uint8_t data[2];
+  Message msgs[] = {
+    {kDeviceAddr, Message::kRead, sizeof(data), data},
+    {0x50, Message::kRead, sizeof(data), data},
+  };
+
+  twiMaster.startTransfer(msgs, 2);
+  runInterrupts();
+  assertEqual(2, twiMaster.result().status);
+  assertEqual(1, twiMaster.result().index);
+  assertEqual(1, SimTwi::numStops);
+}
+
+test(AvrTwiInterfaceTest, startTransferDataNack) {
+  SimTwi::reset();
+  uint8_t buf[kDeviceSize + 2] = {};
+  Message msgs[] = {{kDeviceAddr, 0, sizeof(buf), buf}};
+
+  twiMaster.startTransfer(msgs, 1);
+  runInterrupts();
+  assertEqual(3, twiMaster.result().status);
+  assertEqual(0, twiMaster.result().index);
+  assertEqual(1, SimTwi::numStops);
+}
+
+test(AvrTwiInterfaceTest, transferRejectsEmptyRead) {
+  SimTwi::reset();
+  uint8_t reg = 0;
+  Message msgs[] = {
+    {kDeviceAddr, 0, 1, &reg},
+    {kDeviceAddr, Message::kRead, 0, nullptr},
+  };
+
+  TransferResult result = wireInterface.transfer(msgs, 2);
+  assertEqual(1, result.status);
+  assertEqual(1, result.index);
+  assertEqual(0, SimTwi::numStarts);
+}
+
+test(AvrTwiInterfaceTest, transferTimeout) {
+  SimTwi::reset();
+  uint8_t reg = 0;
+  Message msgs[] = {{kDeviceAddr, 0, 1, &reg}};
+
+  // There is no TWI interrupt on the host, so the transfer never completes.
+  TransferResult result = wireInterface.transfer(msgs, 1);
+  assertEqual(5, result.status);
+  assertEqual(0, result.index);
+  assertFalse(twiMaster.isBusy());
+
+  // The interrupt is disabled and the bus is released with a STOP.
+  assertEqual(0, SimTwi::twcr & kTwie);
+  assertEqual(1, SimTwi::numStops);
+}
+
+//-----------------------------------------------------------------------------
+
+void setup() {
+#if ! defined(EPOXY_DUINO)
+  delay(1000); // wait to prevent garbage on SERIAL_PORT_MONITOR
+#endif
+  SERIAL_PORT_MONITOR.begin(115200);
+  while (!SERIAL_PORT_MONITOR); // Leonardo/Micro
+
+  wireInterface.begin();
+}
+
+void loop() {
+  TestRunner::run();
+}
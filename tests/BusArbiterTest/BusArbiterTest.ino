@@ -0,0 +1,140 @@
+#line 2 "BusArbiterTest.ino"
+
+#include <AUnit.h>
+#include <AceWire.h>
+
+using aunit::TestRunner;
+using namespace ace_wire;
+
+using Arbiter = BusArbiter<4>;
+
+//-----------------------------------------------------------------------------
+// The order in which the waiting clients get the bus.
+//-----------------------------------------------------------------------------
+
+test(BusArbiterTest, fifoOrder) {
+  Arbiter arbiter(Arbiter::kFifo);
+  assertTrue(arbiter.tryAcquire(0));
+  assertTrue(arbiter.tryAcquire(0));
+  assertEqual(0, arbiter.owner());
+
+  // Clients 3, 1, 2 start waiting in that order.
+  assertFalse(arbiter.tryAcquire(3));
+  assertFalse(arbiter.tryAcquire(1));
+  assertFalse(arbiter.tryAcquire(2));
+  arbiter.release(0);
+  assertFalse(arbiter.isBusy());
+
+  // Only the oldest waiting client gets the bus.
+  assertFalse(arbiter.tryAcquire(1));
+  assertFalse(arbiter.tryAcquire(2));
+  assertTrue(arbiter.tryAcquire(3));
+  arbiter.release(3);
+  assertFalse(arbiter.tryAcquire(2));
+  assertTrue(arbiter.tryAcquire(1));
+  arbiter.release(1);
+  assertTrue(arbiter.tryAcquire(2));
+  arbiter.release(2);
+  assertEqual(Arbiter::kNoClient, arbiter.owner());
+}
+
+test(BusArbiterTest, priorityOrder) {
+  Arbiter arbiter(Arbiter::kPriority);
+  arbiter.setPriority(2, 5);
+  arbiter.setPriority(3, 5);
+  assertTrue(arbiter.tryAcquire(0));
+
+  assertFalse(arbiter.tryAcquire(1));
+  assertFalse(arbiter.tryAcquire(3));
+  assertFalse(arbiter.tryAcquire(2));
+  arbiter.release(0);
+
+  // The highest priority first, then FIFO among the equal priorities.
+  assertFalse(arbiter.tryAcquire(1));
+  assertFalse(arbiter.tryAcquire(2));
+  assertTrue(arbiter.tryAcquire(3));
+  arbiter.release(3);
+  assertFalse(arbiter.tryAcquire(1));
+  assertTrue(arbiter.tryAcquire(2));
+  arbiter.release(2);
+  assertTrue(arbiter.tryAcquire(1));
+  arbiter.release(1);
+}
+
+test(BusArbiterTest, cancelUnblocksLaterClients) {
+  Arbiter arbiter(Arbiter::kFifo);
+  assertTrue(arbiter.tryAcquire(0));
+  assertFalse(arbiter.tryAcquire(1));
+  assertFalse(arbiter.tryAcquire(2));
+  arbiter.release(0);
+
+  assertFalse(arbiter.tryAcquire(2));
+  arbiter.cancel(1);
+  assertTrue(arbiter.tryAcquire(2));
+  arbiter.release(2);
+
+  // Release and cancel by other clients are ignored.
+  assertTrue(arbiter.tryAcquire(1));
+  arbiter.release(2);
+  arbiter.cancel(1);
+  assertEqual(1, arbiter.owner());
+  arbiter.release(1);
+}
+
+test(BusArbiterTest, orderSurvivesTicketWrap) {
+  Arbiter arbiter(Arbiter::kPriority);
+  arbiter.setPriority(0, 1);
+  assertTrue(arbiter.tryAcquire(0));
+  assertFalse(arbiter.tryAcquire(1));
+
+  // Client 0 has precedence, and takes a new ticket for each acquisition
+  // while client 1 waits. Client 2 starts waiting after the 8-bit tickets
+  // would have wrapped around.
+  for (uint16_t i = 0; i < 300; ++i) {
+    if (i == 250) assertFalse(arbiter.tryAcquire(2));
+    arbiter.release(0);
+    assertTrue(arbiter.tryAcquire(0));
+  }
+  arbiter.release(0);
+
+  assertFalse(arbiter.tryAcquire(2));
+  assertTrue(arbiter.tryAcquire(1));
+  arbiter.release(1);
+  assertTrue(arbiter.tryAcquire(2));
+  arbiter.release(2);
+  assertEqual(301, arbiter.stats(0).acquisitions);
+}
+
+//-----------------------------------------------------------------------------
+// Statistics.
+//-----------------------------------------------------------------------------
+
+test(BusArbiterTest, statsCountAcquisitions) {
+  Arbiter arbiter(Arbiter::kFifo);
+  for (uint8_t i = 0; i < 3; ++i) {
+    assertTrue(arbiter.tryAcquire(1));
+    arbiter.release(1);
+  }
+  assertEqual(3, arbiter.stats(1).acquisitions);
+  assertEqual(0, arbiter.stats(0).acquisitions);
+  assertTrue(arbiter.stats(1).maxHoldMicros <= arbiter.stats(1).holdMicros);
+  assertTrue(arbiter.stats(1).maxWaitMicros <= arbiter.stats(1).waitMicros);
+
+  arbiter.resetStats();
+  assertEqual(0, arbiter.stats(1).acquisitions);
+  assertEqual((uint32_t) 0, arbiter.stats(1).holdMicros);
+}
+
+//-----------------------------------------------------------------------------
+
+void setup() {
+#if ! defined(EPOXY_DUINO)
+  delay(1000); // wait to prevent garbage on SERIAL_PORT_MONITOR
+#endif
+  SERIAL_PORT_MONITOR.begin(115200);
+  while (!SERIAL_PORT_MONITOR); // Leonardo/Micro
+}
+
+void loop() {
+  TestRunner::run();
+}
@@ -0,0 +1,206 @@
+#line 2 "LinuxI2cDevInterfaceTest.ino"
+
+#include <string.h> // memset()
+#include <AUnit.h>
+#include <AceWire.h>
+
+using aunit::TestRunner;
+
+// The i2c-dev interface exists only on Linux.
+#if defined(__linux__)
+
+#include <ace_wire/LinuxI2cDevInterface.h>
+
+using namespace ace_wire;
+
+//-----------------------------------------------------------------------------
+// A replacement of the I2C_RDWR ioctl() which records the segments of each
+// call, and fills the read segments with 1, 2, 3, ...
+//-----------------------------------------------------------------------------
+
+const uint8_t kMaxSegments = 8;
+
+struct Segment {
+  uint16_t addr;
+  uint16_t flags;
+  uint16_t len;
+  uint8_t first; // first byte of a write segment
+};
+
+int numCalls;
+int nextErrno;
+uint8_t numSegments; // of the last call
+Segment segments[kMaxSegments];
+
+int fakeRdwr(int /*fd*/, struct i2c_rdwr_ioctl_data* data) {
+  numCalls++;
+  numSegments = data->nmsgs;
+  for (uint8_t i = 0; i < data->nmsgs && i < kMaxSegments; ++i) {
+    const struct i2c_msg& msg = data->msgs[i];
+    segments[i] = Segment{msg.addr, msg.flags, msg.len, msg.buf[0]};
+    if (msg.flags & I2C_M_RD) {
+      for (uint16_t j = 0; j < msg.len; ++j) msg.buf[j] = j + 1;
+    }
+  }
+  return nextErrno;
+}
+
+LinuxI2cDev i2cDev(fakeRdwr);
+LinuxI2cDevInterface wireInterface(i2cDev);
+
+void resetFake() {
+  numCalls = 0;
+  nextErrno = 0;
+  numSegments = 0;
+  memset(segments, 0, sizeof(segments));
+}
+
+//-----------------------------------------------------------------------------
+
+test(LinuxI2cDevInterfaceTest, registerReadIsOneIoctl) {
+  resetFake();
+  wireInterface.beginTransmission(0x68);
+  wireInterface.write(0x00);
+  assertEqual(0, wireInterface.endTransmission(false));
+  assertEqual(0, numCalls);
+
+  assertEqual(3, wireInterface.requestFrom(0x68, 3));
+  assertEqual(1, numCalls);
+  assertEqual(2, numSegments);
+  assertEqual(0x68, segments[0].addr);
+  assertEqual(0, segments[0].flags);
+  assertEqual(1, segments[0].len);
+  assertEqual(I2C_M_RD, segments[1].flags);
+  assertEqual(3, segments[1].len);
+
+  assertEqual(1, wireInterface.read());
+  assertEqual(2, wireInterface.read());
+  assertEqual(3, wireInterface.read());
+  assertEqual(0xff, wireInterface.read());
+}
+
+test(LinuxI2cDevInterfaceTest, write) {
+  resetFake();
+  wireInterface.beginTransmission(0x50);
+  for (uint8_t i = 0; i < 10; ++i) {
+    assertEqual(1, wireInterface.write(i));
+  }
+  assertEqual(0, wireInterface.endTransmission());
+  assertEqual(1, numCalls);
+  assertEqual(1, numSegments);
+  assertEqual(10, segments[0].len);
+}
+
+test(LinuxI2cDevInterfaceTest, errnoToStatus) {
+  resetFake();
+  nextErrno = ENXIO;
+  assertEqual(0, wireInterface.requestFrom(0x50, 1));
+  wireInterface.beginTransmission(0x50);
+  assertEqual(2, wireInterface.endTransmission());
+
+  nextErrno = EIO;
+  wireInterface.beginTransmission(0x50);
+  assertEqual(4, wireInterface.endTransmission());
+}
+
+test(LinuxI2cDevInterfaceTest, overflow) {
+  resetFake();
+  wireInterface.beginTransmission(0x50);
+  for (uint16_t i = 0; i < LinuxI2cDev::kBufferSize + 1; ++i) {
+    wireInterface.write(i);
+  }
+  assertEqual(1, wireInterface.endTransmission());
+  assertEqual(0, wireInterface.requestFrom(0x50, LinuxI2cDev::kBufferSize + 1));
+  assertEqual(0, numCalls);
+
+  // Nothing is pending, so no ioctl() is made.
+  assertEqual(0, wireInterface.endTransmission());
+  assertEqual(0, numCalls);
+}
+
+// The pieces of a BulkTransfer are joined with endTransmission(false), so the
+// earlier pieces are submitted when the buffers are full.
+test(LinuxI2cDevInterfaceTest, bulkWriteLargerThanBuffer) {
+  resetFake();
+  BulkTransfer<LinuxI2cDevInterface> bulk(wireInterface);
+  const uint8_t prefix = 0x40;
+  uint8_t data[600];
+  for (uint16_t i = 0; i < sizeof(data); ++i) data[i] = i;
+  assertEqual(0, bulk.write(0x3C, &prefix, 1, data, sizeof(data)));
+  assertEqual(3, numCalls);
+  assertEqual(1, numSegments);
+  assertEqual(600 - 2 * 255 + 1, segments[0].len);
+  assertEqual(0x40, segments[0].first);
+
+  // More pieces than i2c_msg entries.
+  resetFake();
+  BulkTransfer<LinuxI2cDevInterface> small(wireInterface, 4);
+  assertEqual(0, small.write(0x3C, nullptr, 0, data, 40));
+  assertEqual(2, numCalls);
+  assertEqual(2, numSegments);
+  assertEqual(4, segments[1].len);
+  assertEqual(36, segments[1].first);
+
+  // An error of an early ioctl() is reported at the end.
+  resetFake();
+  nextErrno = ENXIO;
+  assertEqual(2, bulk.write(0x3C, &prefix, 1, data, sizeof(data)));
+  assertEqual(1, numCalls);
+}
+
+test(LinuxI2cDevInterfaceTest, transfer) {
+  resetFake();
+  uint8_t reg = 0x07;
+  uint8_t buf[4];
+  Message msgs[] = {
+    {0x68, 0, 1, &reg},
+    {0x68, Message::kRead, 4, buf},
+  };
+  TransferResult result = wireInterface.transfer(msgs, 2);
+  assertEqual(0, result.status);
+  assertEqual(2, result.index);
+  assertEqual(1, numCalls);
+  assertEqual(2, numSegments);
+  assertEqual(4, buf[3]);
+
+  Message empty[] = {
+    {0x68, 0, 1, &reg},
+    {0x68, Message::kRead, 0, buf},
+  };
+  result = wireInterface.transfer(empty, 2);
+  assertEqual(1, result.status);
+  assertEqual(1, result.index);
+  assertEqual(1, numCalls);
+}
+
+test(LinuxI2cDevInterfaceTest, memoryDevice) {
+  resetFake();
+  MemoryDevice<LinuxI2cDevInterface> eeprom(wireInterface, 0x50, 2, 32);
+  uint8_t buf[100];
+  assertEqual(0, eeprom.read(0, buf, 100));
+  assertEqual(1, numCalls);
+  assertEqual(2, segments[0].len);
+  assertEqual(100, segments[1].len);
+  assertEqual(100, buf[99]);
+}
+
+#endif
+
+//-----------------------------------------------------------------------------
+
+void setup() {
+#if ! defined(EPOXY_DUINO)
+  delay(1000); // wait to prevent garbage on SERIAL_PORT_MONITOR
+#endif
+  SERIAL_PORT_MONITOR.begin(115200);
+  while (!SERIAL_PORT_MONITOR); // Leonardo/Micro
+
+#if defined(__linux__)
+  // Any file descriptor will do, since it is used only by fakeRdwr().
+  i2cDev.open("/dev/null");
+#endif
+}
+
+void loop() {
+  TestRunner::run();
+}
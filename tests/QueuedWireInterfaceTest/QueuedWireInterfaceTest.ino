@@ -0,0 +1,231 @@
+#line 2 "QueuedWireInterfaceTest.ino"
+
+#include <AUnit.h>
+#include <AceWire.h>
+
+using aunit::TestRunner;
+
+// The worker runs on a pthread, which is available under EpoxyDuino on Linux.
+#if defined(__linux__)
+
+#include <pthread.h>
+#include <sched.h> // sched_yield()
+
+using namespace ace_wire;
+
+//-----------------------------------------------------------------------------
+// A fake interface executed by the worker thread. It NACKs the address of
+// kMissing, and records the bytes written to kDevice in a log, which the
+// producer inspects only after flush(). Each read returns the next value of a
+// counter.
+//-----------------------------------------------------------------------------
+
+const uint8_t kDevice = 0x50;
+const uint8_t kMissing = 0x51;
+const uint16_t kLogSize = 4096;
+
+uint8_t writeLog[kLogSize];
+uint16_t writeLogLen;
+uint8_t nextRead;
+bool addressNack;
+
+class FakeWireInterface {
+  public:
+    static const bool kSupportsRepeatedStart = true;
+    static const bool kBuffered = false;
+    static const uint16_t kBufferSize = 0;
+    static const uint16_t kMaxQuantity = 65535;
+    static const bool kReportsAddressNack = true;
+
+    void begin() const {}
+    void end() const {}
+
+    uint8_t beginTransmission(uint8_t addr) const {
+      addressNack = (addr != kDevice);
+      return addressNack;
+    }
+
+    uint8_t write(uint8_t data) const {
+      if (addressNack) return 0;
+      if (writeLogLen < kLogSize) writeLog[writeLogLen++] = data;
+      return 1;
+    }
+
+    uint8_t endTransmission(bool /*sendStop*/ = true) const {
+      return addressNack ? 2 : 0;
+    }
+
+    uint16_t requestFrom(
+        uint8_t addr, uint16_t quantity, bool /*sendStop*/ = true) const {
+      return (addr == kDevice) ? quantity : 0;
+    }
+
+    uint8_t read() const { return nextRead++; }
+};
+
+using Queue = WireQueue<FakeWireInterface, 4, 8>;
+
+FakeWireInterface fakeInterface;
+Queue queue(fakeInterface);
+QueuedWireInterface<Queue> postedInterface(queue);
+QueuedWireInterface<Queue, false> waitingInterface(queue);
+
+void* runWorker(void*) {
+  for (;;) {
+    if (! queue.runOnce()) sched_yield();
+  }
+  return nullptr;
+}
+
+// Reset the fake. Called only when the queue is empty.
+void resetFake() {
+  queue.flush();
+  writeLogLen = 0;
+  nextRead = 0;
+}
+
+//-----------------------------------------------------------------------------
+
+test(QueuedWireInterfaceTest, submitStress) {
+  resetFake();
+  const uint16_t kCount = 1000;
+  uint8_t data[2];
+  uint16_t numSubmitted = 0;
+  uint16_t numCompleted = 0;
+
+  // The queue holds only 4 requests, so the producer and the worker run in
+  // lock step around a full ring most of the time.
+  while (numCompleted < kCount) {
+    if (numSubmitted < kCount) {
+      data[0] = (uint8_t) numSubmitted;
+      data[1] = (uint8_t) (numSubmitted >> 8);
+      if (queue.submit(Message{kDevice, 0, 2, data}, true,
+          (uint8_t) numSubmitted)) {
+        numSubmitted++;
+      }
+    }
+    WireCompletion completion;
+    if (queue.pollCompletion(completion)) {
+      assertEqual((uint8_t) numCompleted, completion.tag);
+      assertEqual(0, completion.status);
+      numCompleted++;
+    }
+  }
+  assertEqual(0, queue.flush());
+  assertEqual(0, queue.droppedCompletions());
+
+  // The data was copied into the queue, so reusing `data` is safe, and the
+  // worker executed the segments in order.
+  assertEqual(2 * kCount, writeLogLen);
+  for (uint16_t i = 0; i < kCount; ++i) {
+    assertEqual((uint8_t) i, writeLog[2 * i]);
+    assertEqual((uint8_t) (i >> 8), writeLog[2 * i + 1]);
+  }
+}
+
+test(QueuedWireInterfaceTest, postedWritesInOrder) {
+  resetFake();
+  for (uint16_t i = 0; i < 500; ++i) {
+    postedInterface.beginTransmission(kDevice);
+    postedInterface.write((uint8_t) i);
+    assertEqual(0, postedInterface.endTransmission());
+  }
+  assertEqual(0, queue.flush());
+  assertEqual(500, writeLogLen);
+  for (uint16_t i = 0; i < 500; ++i) {
+    assertEqual((uint8_t) i, writeLog[i]);
+  }
+}
+
+test(QueuedWireInterfaceTest, postedWriteFailureReportedByFlush) {
+  resetFake();
+  postedInterface.beginTransmission(kMissing);
+  postedInterface.write(0x01);
+  assertEqual(0, postedInterface.endTransmission());
+  postedInterface.beginTransmission(kDevice);
+  postedInterface.write(0x02);
+  assertEqual(0, postedInterface.endTransmission());
+
+  // The first failure is reported once, and the later writes still ran.
+  assertEqual(2, queue.flush());
+  assertEqual(0, queue.flush());
+  assertEqual(1, writeLogLen);
+  assertEqual(0x02, writeLog[0]);
+}
+
+test(QueuedWireInterfaceTest, waitingWriteReturnsStatus) {
+  resetFake();
+  waitingInterface.beginTransmission(kMissing);
+  assertEqual(2, waitingInterface.endTransmission());
+  waitingInterface.beginTransmission(kDevice);
+  waitingInterface.write(0x03);
+  assertEqual(0, waitingInterface.endTransmission());
+
+  // Not posted, so flush() has nothing to report.
+  assertEqual(0, queue.flush());
+}
+
+test(QueuedWireInterfaceTest, overlongWriteIsRejected) {
+  resetFake();
+  postedInterface.beginTransmission(kDevice);
+  for (uint8_t i = 0; i < Queue::kDataSize; ++i) {
+    assertEqual(1, postedInterface.write(i));
+  }
+  assertEqual(0, postedInterface.write(0xFF));
+  assertEqual(1, postedInterface.endTransmission());
+  assertEqual(0, queue.flush());
+  assertEqual(0, writeLogLen);
+}
+
+test(QueuedWireInterfaceTest, requestFromWaitsForWorker) {
+  resetFake();
+  assertEqual(3, postedInterface.requestFrom(kDevice, 3));
+  assertEqual(0, postedInterface.read());
+  assertEqual(1, postedInterface.read());
+  assertEqual(2, postedInterface.read());
+  assertEqual(0xff, postedInterface.read());
+  assertEqual(0, postedInterface.requestFrom(kMissing, 3));
+  assertEqual(0, postedInterface.requestFrom(kDevice, Queue::kDataSize + 1));
+}
+
+test(QueuedWireInterfaceTest, submittedReadFillsCallerBuffer) {
+  resetFake();
+  uint8_t reg = 0x10;
+  uint8_t data[3] = {0};
+  assertTrue(queue.submit(Message{kDevice, 0, 1, &reg}, false, 1));
+  assertTrue(queue.submit(Message{kDevice, Message::kRead, 3, data}, true, 2));
+  assertTrue(queue.submit(Message{kMissing, Message::kRead, 1, data}, true, 3));
+
+  WireCompletion completion;
+  for (uint8_t tag = 1; tag <= 3; ++tag) {
+    while (! queue.pollCompletion(completion)) sched_yield();
+    assertEqual(tag, completion.tag);
+    assertEqual(tag == 3 ? 2 : 0, completion.status);
+  }
+  assertEqual(0x10, writeLog[0]);
+  assertEqual(0, data[0]);
+  assertEqual(2, data[2]);
+}
+
+#endif
+
+//-----------------------------------------------------------------------------
+
+void setup() {
+#if ! defined(EPOXY_DUINO)
+  delay(1000); // wait to prevent garbage on SERIAL_PORT_MONITOR
+#endif
+  SERIAL_PORT_MONITOR.begin(115200);
+  while (!SERIAL_PORT_MONITOR); // Leonardo/Micro
+
+#if defined(__linux__)
+  // The worker runs until the test process exits.
+  pthread_t worker;
+  pthread_create(&worker, nullptr, runWorker, nullptr);
+  pthread_detach(worker);
+#endif
+}
+
+void loop() {
+  TestRunner::run();
+}
@@ -0,0 +1,303 @@
+#line 2 "RateControllerTest.ino"
+
+#include <AUnit.h>
+#include <AceWire.h>
+
+using aunit::TestRunner;
+using namespace ace_wire;
+
+//-----------------------------------------------------------------------------
+// A controller of 2 devices with 4 steps, which raises the speed after 4
+// clean transactions, and lowers it after 2 errors within 8 transactions.
+//-----------------------------------------------------------------------------
+
+const uint8_t kDevice = 0x50;
+const uint8_t kOther = 0x68;
+const uint8_t kMissing = 0x51;
+
+const uint8_t DELAY_STEPS[] = {10, 5, 2, 0}; // slowest to fastest
+const uint8_t NUM_STEPS = 4;
+const uint8_t HISTORY_SIZE = 4;
+
+using Controller = RateController<DelayProfile, 8, HISTORY_SIZE>;
+
+DelayProfile profiles[2];
+
+void resetProfiles() {
+  profiles[0] = DelayProfile{kDevice, 0};
+  profiles[1] = DelayProfile{kOther, 0};
+}
+
+void reportMany(Controller& controller, uint8_t addr, bool ok, uint8_t n) {
+  for (uint8_t i = 0; i < n; ++i) controller.report(addr, ok);
+}
+
+//-----------------------------------------------------------------------------
+// The state machine of RateController.
+//-----------------------------------------------------------------------------
+
+test(RateControllerTest, initialStepIsWrittenToProfiles) {
+  resetProfiles();
+  Controller controller(profiles, 2, DELAY_STEPS, NUM_STEPS, 1, 4, 2, 8);
+  assertEqual(1, controller.step(kDevice));
+  assertEqual(5, profiles[0].delayMicros);
+  assertEqual(5, profiles[1].delayMicros);
+  assertEqual(Controller::kNoStep, controller.step(kMissing));
+  assertTrue(controller.stats(kMissing) == nullptr);
+}
+
+test(RateControllerTest, stepDownAfterErrorThreshold) {
+  resetProfiles();
+  Controller controller(profiles, 2, DELAY_STEPS, NUM_STEPS, 1, 4, 2, 8);
+
+  controller.report(kDevice, false);
+  assertEqual(1, controller.step(kDevice));
+  controller.reportError(kDevice);
+  assertEqual(0, controller.step(kDevice));
+  assertEqual(10, profiles[0].delayMicros);
+  assertEqual(5, profiles[1].delayMicros);
+
+  // The slowest step cannot be lowered.
+  reportMany(controller, kDevice, false, 4);
+  assertEqual(0, controller.step(kDevice));
+
+  const RateStats* stats = controller.stats(kDevice);
+  assertEqual((uint32_t) 6, stats->transactions);
+  assertEqual((uint32_t) 6, stats->errors);
+  assertEqual(1, stats->stepDowns);
+  assertEqual(0, stats->stepUps);
+}
+
+test(RateControllerTest, errorsExpireWithWindow) {
+  resetProfiles();
+  // A clean window longer than the error window, so that the speed is not
+  // raised in between.
+  Controller controller(profiles, 2, DELAY_STEPS, NUM_STEPS, 1, 100, 2, 8);
+
+  controller.report(kDevice, false);
+  reportMany(controller, kDevice, true, 7);
+  controller.report(kDevice, false);
+  assertEqual(1, controller.step(kDevice));
+  controller.report(kDevice, false);
+  assertEqual(0, controller.step(kDevice));
+}
+
+test(RateControllerTest, stepUpAfterCleanWindow) {
+  resetProfiles();
+  Controller controller(profiles, 2, DELAY_STEPS, NUM_STEPS, 1, 4, 2, 8);
+
+  reportMany(controller, kDevice, true, 3);
+  assertEqual(1, controller.step(kDevice));
+  controller.report(kDevice, true);
+  assertEqual(2, controller.step(kDevice));
+  assertEqual(2, profiles[0].delayMicros);
+  assertEqual(1, controller.stats(kDevice)->stepUps);
+
+  // An error resets the clean run.
+  reportMany(controller, kDevice, true, 3);
+  controller.report(kDevice, false);
+  reportMany(controller, kDevice, true, 3);
+  assertEqual(2, controller.step(kDevice));
+  controller.report(kDevice, true);
+  assertEqual(3, controller.step(kDevice));
+
+  // The fastest step cannot be raised.
+  reportMany(controller, kDevice, true, 8);
+  assertEqual(3, controller.step(kDevice));
+}
+
+test(RateControllerTest, failedProbeDoublesCleanWindow) {
+  resetProfiles();
+  Controller controller(profiles, 2, DELAY_STEPS, NUM_STEPS, 1, 4, 2, 8);
+
+  // Probe step 2, which fails: 8 clean transactions are needed next time.
+  reportMany(controller, kDevice, true, 4);
+  assertEqual(2, controller.step(kDevice));
+  reportMany(controller, kDevice, false, 2);
+  assertEqual(1, controller.step(kDevice));
+  reportMany(controller, kDevice, true, 7);
+  assertEqual(1, controller.step(kDevice));
+  controller.report(kDevice, true);
+  assertEqual(2, controller.step(kDevice));
+
+  // It fails again: 16 are needed.
+  reportMany(controller, kDevice, false, 2);
+  assertEqual(1, controller.step(kDevice));
+  reportMany(controller, kDevice, true, 15);
+  assertEqual(1, controller.step(kDevice));
+  controller.report(kDevice, true);
+  assertEqual(2, controller.step(kDevice));
+
+  // Step 2 completes its own clean window, which resets the backoff, and
+  // raises the speed again.
+  reportMany(controller, kDevice, true, 4);
+  assertEqual(3, controller.step(kDevice));
+
+  // setStep() also resets the backoff.
+  controller.setStep(kDevice, 1);
+  reportMany(controller, kDevice, true, 4);
+  assertEqual(2, controller.step(kDevice));
+}
+
+test(RateControllerTest, historyKeepsMostRecentChanges) {
+  resetProfiles();
+  Controller controller(profiles, 2, DELAY_STEPS, NUM_STEPS, 0, 4, 2, 8);
+
+  // 6 changes: up to 3 on kDevice, then up to 3 on kOther.
+  reportMany(controller, kDevice, true, 12);
+  reportMany(controller, kOther, true, 12);
+  assertEqual((uint32_t) 6, controller.numChanges());
+  assertEqual(HISTORY_SIZE, controller.historySize());
+
+  // The first 2 changes of kDevice were dropped.
+  assertEqual(kDevice, controller.history(0).addr);
+  assertEqual(3, controller.history(0).step);
+  assertEqual(kOther, controller.history(1).addr);
+  assertEqual(1, controller.history(1).step);
+  assertEqual(kOther, controller.history(3).addr);
+  assertEqual(3, controller.history(3).step);
+}
+
+test(RateControllerTest, unknownDevicesAreIgnored) {
+  resetProfiles();
+  Controller controller(profiles, 2, DELAY_STEPS, NUM_STEPS, 1, 4, 2, 8);
+  reportMany(controller, kMissing, false, 4);
+  controller.reportAddressNack(kMissing);
+  assertFalse(controller.setStep(kMissing, 0));
+  assertEqual((uint32_t) 0, controller.numChanges());
+}
+
+//-----------------------------------------------------------------------------
+// The outcomes reported by AdaptiveWireInterface. The fake interface NACKs
+// the address of kMissing, and the data byte kNackData.
+//-----------------------------------------------------------------------------
+
+const uint8_t kNackData = 0xEE;
+
+class FakeWireInterface {
+  public:
+    static const bool kSupportsRepeatedStart = true;
+    static const bool kBuffered = false;
+    static const uint16_t kBufferSize = 0;
+    static const uint16_t kMaxQuantity = 65535;
+    static const bool kReportsAddressNack = true;
+
+    void begin() const {}
+    void end() const {}
+
+    uint8_t beginTransmission(uint8_t addr) const {
+      mAddressNack = (addr == kMissing);
+      mDataNack = false;
+      return mAddressNack;
+    }
+
+    uint8_t write(uint8_t data) const {
+      if (mAddressNack || data == kNackData) mDataNack = true;
+      return ! mDataNack;
+    }
+
+    uint8_t endTransmission(bool /*sendStop*/ = true) const {
+      return mAddressNack ? 2 : mDataNack ? 3 : 0;
+    }
+
+    uint16_t requestFrom(
+        uint8_t addr, uint16_t quantity, bool /*sendStop*/ = true) const {
+      return (addr == kMissing) ? 0 : quantity;
+    }
+
+    uint8_t read() const { return 0; }
+
+    TransferResult transfer(const Message* msgs, uint8_t count) const {
+      for (uint8_t i = 0; i < count; ++i) {
+        if (msgs[i].addr == kMissing) return TransferResult{2, i};
+        if (! (msgs[i].flags & Message::kRead) && msgs[i].buf[0] == kNackData) {
+          return TransferResult{3, i};
+        }
+      }
+      return TransferResult{0, count};
+    }
+
+    template <typename F>
+    uint32_t readInto(
+        uint8_t addr, uint16_t quantity, F&& sink, bool /*sendStop*/ = true)
+        const {
+      if (addr == kMissing) return 0;
+      sink(0);
+      return quantity;
+    }
+
+  private:
+    mutable bool mAddressNack = false;
+    mutable bool mDataNack = false;
+};
+
+FakeWireInterface fakeInterface;
+
+void writeByte(
+    const AdaptiveWireInterface<FakeWireInterface, Controller>& wireInterface,
+    uint8_t addr, uint8_t data) {
+  wireInterface.beginTransmission(addr);
+  wireInterface.write(data);
+  wireInterface.endTransmission();
+}
+
+test(RateControllerTest, addressNacksAreOnlyCountedByDefault) {
+  DelayProfile nackProfiles[] = {{kMissing, 0}, {kDevice, 0}};
+  Controller controller(nackProfiles, 2, DELAY_STEPS, NUM_STEPS, 1, 4, 2, 8);
+  AdaptiveWireInterface<FakeWireInterface, Controller> wireInterface(
+      fakeInterface, controller);
+
+  writeByte(wireInterface, kMissing, 0x00);
+  assertEqual(0, wireInterface.requestFrom(kMissing, 2));
+  uint8_t buf = 0;
+  Message msgs[] = {{kMissing, 0, 1, &buf}};
+  assertEqual(2, wireInterface.transfer(msgs, 1).status);
+  assertEqual((uint32_t) 0, wireInterface.readInto(
+      kMissing, 1, [](uint8_t) { return true; }));
+
+  const RateStats* stats = controller.stats(kMissing);
+  assertEqual((uint32_t) 4, stats->addressNacks);
+  assertEqual((uint32_t) 0, stats->transactions);
+  assertEqual((uint32_t) 0, stats->errors);
+  assertEqual(1, controller.step(kMissing));
+
+  // A data NACK is an error.
+  writeByte(wireInterface, kDevice, kNackData);
+  buf = kNackData;
+  msgs[0].addr = kDevice;
+  assertEqual(3, wireInterface.transfer(msgs, 1).status);
+  stats = controller.stats(kDevice);
+  assertEqual((uint32_t) 2, stats->errors);
+  assertEqual((uint32_t) 0, stats->addressNacks);
+  assertEqual(0, controller.step(kDevice));
+}
+
+test(RateControllerTest, addressNacksCountedIfEnabled) {
+  DelayProfile nackProfiles[] = {{kMissing, 0}};
+  Controller controller(
+      nackProfiles, 1, DELAY_STEPS, NUM_STEPS, 1, 4, 2, 8, true);
+  AdaptiveWireInterface<FakeWireInterface, Controller> wireInterface(
+      fakeInterface, controller);
+
+  writeByte(wireInterface, kMissing, 0x00);
+  assertEqual(0, wireInterface.requestFrom(kMissing, 2));
+
+  const RateStats* stats = controller.stats(kMissing);
+  assertEqual((uint32_t) 2, stats->addressNacks);
+  assertEqual((uint32_t) 2, stats->errors);
+  assertEqual(0, controller.step(kMissing));
+}
+
+//-----------------------------------------------------------------------------
+
+void setup() {
+#if ! defined(EPOXY_DUINO)
+  delay(1000); // wait to prevent garbage on SERIAL_PORT_MONITOR
+#endif
+  SERIAL_PORT_MONITOR.begin(115200);
+  while (!SERIAL_PORT_MONITOR); // Leonardo/Micro
+}
+
+void loop() {
+  TestRunner::run();
+}
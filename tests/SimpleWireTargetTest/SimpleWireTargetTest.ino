@@ -0,0 +1,229 @@
+#line 2 "SimpleWireTargetTest.ino"
+
+#include <AUnit.h>
+#include <AceWire.h>
+
+using aunit::TestRunner;
+using namespace ace_wire;
+
+//-----------------------------------------------------------------------------
+// A simulated open-drain bus, which connects a SimpleWireFastInterface master
+// on pins 2 (SDA) and 3 (SCL) to a SimpleWireTarget on pins 4 (SDA) and 5
+// (SCL) as a wired-AND: a line is LOW if either side drives it as an OUTPUT.
+// Each change of a master pin calls the handler of the target, in place of
+// the pin change interrupt.
+//-----------------------------------------------------------------------------
+
+const uint8_t MASTER_SDA = 2;
+const uint8_t MASTER_SCL = 3;
+const uint8_t TARGET_SDA = 4;
+const uint8_t TARGET_SCL = 5;
+const uint8_t NUM_PINS = 6;
+
+uint8_t pinModes[NUM_PINS];
+
+void handleMasterChange();
+
+void simPinMode(uint8_t pin, uint8_t mode) {
+  pinModes[pin] = mode;
+  if (pin == MASTER_SDA || pin == MASTER_SCL) handleMasterChange();
+}
+
+uint8_t simDigitalRead(uint8_t pin) {
+  bool sda = (pin == MASTER_SDA || pin == TARGET_SDA);
+  uint8_t master = sda ? MASTER_SDA : MASTER_SCL;
+  uint8_t target = sda ? TARGET_SDA : TARGET_SCL;
+  return (pinModes[master] == OUTPUT || pinModes[target] == OUTPUT)
+      ? LOW : HIGH;
+}
+
+// Replace the primitives of the digitalWriteFast library. The output latches
+// are always LOW in open-drain mode.
+#define pinModeFast(pin, mode) simPinMode(pin, mode)
+#define digitalReadFast(pin) simDigitalRead(pin)
+#define digitalWriteFast(pin, value) ((void) 0)
+
+#include <ace_wire/SimpleWireFastInterface.h>
+#include <ace_wire/SimpleWireTarget.h>
+
+const uint8_t TARGET_ADDR = 0x42;
+const uint8_t NUM_REGISTERS = 8;
+
+uint8_t registers[NUM_REGISTERS];
+SimpleWireTarget<TARGET_SDA, TARGET_SCL> target(
+    TARGET_ADDR, registers, NUM_REGISTERS);
+
+using WireInterface = SimpleWireFastInterface<MASTER_SDA, MASTER_SCL, 1>;
+WireInterface wireInterface;
+
+struct LatchOptions : SimpleWireFastOptions {
+  static const bool kLatchErrors = true;
+};
+using LatchInterface = SimpleWireFastInterface<
+    MASTER_SDA, MASTER_SCL, 1, LatchOptions>;
+LatchInterface latchInterface;
+
+void handleMasterChange() {
+  target.handleChange();
+}
+
+// Set the registers to 0x10, 0x11, ... and the register pointer to 0.
+void resetTarget() {
+  for (uint8_t i = 0; i < NUM_REGISTERS; ++i) registers[i] = 0x10 + i;
+  wireInterface.beginTransmission(TARGET_ADDR);
+  wireInterface.write(0);
+  wireInterface.endTransmission();
+}
+
+//-----------------------------------------------------------------------------
+
+test(SimpleWireTargetTest, write) {
+  resetTarget();
+  assertEqual(0, wireInterface.beginTransmission(TARGET_ADDR));
+  assertEqual(1, wireInterface.write(2)); // register pointer
+  assertEqual(1, wireInterface.write(0xA5));
+  assertEqual(1, wireInterface.write(0x5A));
+  assertEqual(0, wireInterface.endTransmission());
+
+  assertEqual(0x11, registers[1]);
+  assertEqual(0xA5, registers[2]);
+  assertEqual(0x5A, registers[3]);
+  assertEqual(0x14, registers[4]);
+  assertEqual(4, target.pointer());
+  assertFalse(target.isSelected());
+  assertEqual(0, target.overruns());
+}
+
+test(SimpleWireTargetTest, addressNack) {
+  resetTarget();
+  assertEqual(1, wireInterface.beginTransmission(TARGET_ADDR + 1));
+  wireInterface.endTransmission();
+  assertEqual(0, wireInterface.requestFrom(TARGET_ADDR + 1, 1));
+  assertFalse(target.isSelected());
+  assertEqual(0, target.pointer());
+
+  // The STOP has released the bus, and nothing is left to read.
+  assertEqual(HIGH, simDigitalRead(MASTER_SDA));
+  assertEqual(HIGH, simDigitalRead(MASTER_SCL));
+  assertEqual(0xff, wireInterface.read());
+  assertEqual(1, wireInterface.requestFrom(TARGET_ADDR, 1));
+  assertEqual(0x10, wireInterface.read());
+}
+
+// A latched address NACK of requestFrom() still releases the bus right away,
+// since callers send nothing else after a failed requestFrom().
+test(SimpleWireTargetTest, latchedAddressNack) {
+  resetTarget();
+  assertEqual(0, latchInterface.requestFrom(TARGET_ADDR + 1, 1));
+  assertEqual(HIGH, simDigitalRead(MASTER_SDA));
+  assertEqual(HIGH, simDigitalRead(MASTER_SCL));
+  assertEqual(0xff, latchInterface.read());
+
+  // The status stays latched until endTransmission(), which sends nothing.
+  assertEqual(LatchInterface::kStatusAddressNack,
+      latchInterface.endTransmission());
+  assertEqual(HIGH, simDigitalRead(MASTER_SDA));
+  assertEqual(HIGH, simDigitalRead(MASTER_SCL));
+  assertEqual(0, latchInterface.endTransmission());
+
+  assertEqual(1, latchInterface.beginTransmission(TARGET_ADDR + 1));
+  assertEqual(0, latchInterface.write(0));
+  assertEqual(LatchInterface::kStatusAddressNack,
+      latchInterface.endTransmission());
+  assertEqual(HIGH, simDigitalRead(MASTER_SDA));
+  assertFalse(target.isSelected());
+
+  assertEqual(1, latchInterface.requestFrom(TARGET_ADDR, 1));
+  assertEqual(0x10, latchInterface.read());
+  assertFalse(target.isSelected());
+}
+
+test(SimpleWireTargetTest, readWithRepeatedStart) {
+  resetTarget();
+  wireInterface.beginTransmission(TARGET_ADDR);
+  wireInterface.write(6);
+  wireInterface.endTransmission(false /*sendStop*/);
+
+  // The register pointer wraps around at the end of the window.
+  assertEqual(3, wireInterface.requestFrom(TARGET_ADDR, 3));
+  assertEqual(0x16, wireInterface.read());
+  assertEqual(0x17, wireInterface.read());
+  assertEqual(0x10, wireInterface.read());
+  assertFalse(target.isSelected());
+  assertEqual(0, target.overruns());
+}
+
+test(SimpleWireTargetTest, currentAddressRead) {
+  resetTarget();
+  assertEqual(2, wireInterface.requestFrom(TARGET_ADDR, 2));
+  assertEqual(0x10, wireInterface.read());
+  assertEqual(0x11, wireInterface.read());
+
+  assertEqual(2, wireInterface.requestFrom(TARGET_ADDR, 2));
+  assertEqual(0x12, wireInterface.read());
+  assertEqual(0x13, wireInterface.read());
+}
+
+// The sink is called before the ACK, so the target sends no more bytes after
+// the sink returns false.
+test(SimpleWireTargetTest, readIntoStopsAtSink) {
+  resetTarget();
+  uint8_t count = 0;
+  auto sink = [&](uint8_t data) {
+    count++;
+    return data < 0x11;
+  };
+  assertEqual((uint32_t) 2, wireInterface.readInto(TARGET_ADDR, 0, sink));
+  assertEqual(2, count);
+  assertEqual(2, target.pointer());
+  assertFalse(target.isSelected());
+}
+
+test(SimpleWireTargetTest, readIntoAddressNack) {
+  resetTarget();
+  uint8_t count = 0;
+  auto sink = [&](uint8_t) {
+    count++;
+    return true;
+  };
+  assertEqual((uint32_t) 0, wireInterface.readInto(TARGET_ADDR + 1, 0, sink));
+  assertEqual(0, count);
+
+  // The STOP has released the bus.
+  assertEqual(HIGH, simDigitalRead(MASTER_SDA));
+  assertEqual(HIGH, simDigitalRead(MASTER_SCL));
+}
+
+test(SimpleWireTargetTest, memoryDevice) {
+  resetTarget();
+  MemoryDevice<WireInterface> device(
+      wireInterface, TARGET_ADDR, 1 /*addressSize*/, 0 /*pageSize*/);
+
+  const uint8_t data[4] = {1, 2, 3, 4};
+  assertEqual(0, device.write(4, data, sizeof(data)));
+  assertEqual(4, registers[7]);
+
+  uint8_t buf[4] = {0, 0, 0, 0};
+  assertEqual(0, device.read(3, buf, sizeof(buf)));
+  assertEqual(0x13, buf[0]);
+  assertEqual(1, buf[1]);
+  assertEqual(3, buf[3]);
+  assertEqual(0, target.overruns());
+}
+
+//-----------------------------------------------------------------------------
+
+void setup() {
+#if ! defined(EPOXY_DUINO)
+  delay(1000); // wait to prevent garbage on SERIAL_PORT_MONITOR
+#endif
+  SERIAL_PORT_MONITOR.begin(115200);
+  while (!SERIAL_PORT_MONITOR); // Leonardo/Micro
+
+  target.begin();
+  wireInterface.begin();
+}
+
+void loop() {
+  TestRunner::run();
+}
@@ -0,0 +1,324 @@
+#line 2 "WireLogTest.ino"
+
+#include <AUnit.h>
+#include <AceWire.h>
+
+using aunit::TestRunner;
+using namespace ace_wire;
+
+//-----------------------------------------------------------------------------
+// A fake interface with native transfer() and readInto(), which answers only
+// at kDevice, and serves the bytes 1, 2, 3, ... to each read.
+//-----------------------------------------------------------------------------
+
+const uint8_t kDevice = 0x50;
+const uint8_t kMissing = 0x51;
+
+int nativeTransfers;
+int nativeReads;
+uint8_t nextByte;
+
+class FakeWireInterface {
+  public:
+    static const bool kSupportsRepeatedStart = true;
+    static const bool kBuffered = false;
+    static const uint16_t kBufferSize = 0;
+    static const uint16_t kMaxQuantity = 65535;
+    static const bool kReportsAddressNack = true;
+
+    void begin() const {}
+    void end() const {}
+
+    uint8_t beginTransmission(uint8_t addr) const { return addr != kDevice; }
+
+    uint8_t write(uint8_t /*data*/) const { return 1; }
+
+    uint8_t endTransmission(bool /*sendStop*/ = true) const { return 0; }
+
+    uint16_t requestFrom(
+        uint8_t addr, uint16_t quantity, bool /*sendStop*/ = true) const {
+      nextByte = 1;
+      return (addr == kDevice) ? quantity : 0;
+    }
+
+    uint8_t read() const { return nextByte++; }
+
+    TransferResult transfer(const Message* msgs, uint8_t count) const {
+      nativeTransfers++;
+      for (uint8_t i = 0; i < count; ++i) {
+        if (msgs[i].addr != kDevice) return TransferResult{2, i};
+        if (msgs[i].flags & Message::kRead) {
+          for (uint16_t j = 0; j < msgs[i].len; ++j) msgs[i].buf[j] = j + 1;
+        }
+      }
+      return TransferResult{0, count};
+    }
+
+    template <typename F>
+    uint32_t readInto(
+        uint8_t addr, uint16_t quantity, F&& sink, bool /*sendStop*/ = true)
+        const {
+      nativeReads++;
+      if (addr != kDevice) return 0;
+      uint32_t n = 0;
+      while (quantity == 0 || n < quantity) {
+        n++;
+        if (! sink((uint8_t) n)) break;
+      }
+      return n;
+    }
+};
+
+FakeWireInterface fakeInterface;
+
+uint8_t logBuffer[256];
+WireLog wireLog(logBuffer, sizeof(logBuffer));
+RecordingWireInterface<FakeWireInterface> recorder(fakeInterface, wireLog);
+
+void resetFake() {
+  nativeTransfers = 0;
+  nativeReads = 0;
+  nextByte = 1;
+  wireLog.clear();
+}
+
+// Decode the record at `pos`, and verify its method.
+bool decodeOp(uint32_t& pos, uint8_t op, WireLogRecord& record) {
+  return wireLog.decode(pos, record) && record.op == op;
+}
+
+//-----------------------------------------------------------------------------
+// Encoding of the records. The first record after clear() has a time delta
+// of 0, encoded as a single byte.
+//-----------------------------------------------------------------------------
+
+test(WireLogTest, encodeBeginTransmission) {
+  resetFake();
+  assertEqual(1, recorder.beginTransmission(kMissing));
+
+  // op 1, result 1 in bits 4-7, delta 0, address
+  assertEqual((uint32_t) 3, wireLog.size());
+  assertEqual(0x11, wireLog.data()[0]);
+  assertEqual(0x00, wireLog.data()[1]);
+  assertEqual(kMissing, wireLog.data()[2]);
+}
+
+test(WireLogTest, encodeRequestFrom) {
+  resetFake();
+  assertEqual(200, recorder.requestFrom(kDevice, 200));
+
+  // op 4, sendStop in bit 3, result 1, delta 0, address, then quantity and
+  // received as LEB128 (200 = 0xC8 0x01)
+  const uint8_t expected[] = {0x1C, 0x00, kDevice, 0xC8, 0x01, 0xC8, 0x01};
+  assertEqual((uint32_t) sizeof(expected), wireLog.size());
+  for (uint8_t i = 0; i < sizeof(expected); ++i) {
+    assertEqual(expected[i], wireLog.data()[i]);
+  }
+}
+
+test(WireLogTest, encodeTransfer) {
+  resetFake();
+  uint8_t buf[2] = {0x10, 0x11};
+  Message msgs[] = {{kMissing, 0, 2, buf}};
+  TransferResult result = recorder.transfer(msgs, 1);
+  assertEqual(2, result.status);
+  assertEqual(0, result.index);
+
+  // op 6, result 2, delta 0, address, index, count; no data of the failed
+  // message
+  const uint8_t expected[] = {0x26, 0x00, kMissing, 0x00, 0x01};
+  assertEqual((uint32_t) sizeof(expected), wireLog.size());
+  for (uint8_t i = 0; i < sizeof(expected); ++i) {
+    assertEqual(expected[i], wireLog.data()[i]);
+  }
+}
+
+test(WireLogTest, decodeIsInverseOfAppend) {
+  resetFake();
+  WireLogRecord in = {WireLog::kOpTransfer, 0x68, 3, false, 5, 300, 0, 0};
+  assertTrue(wireLog.append(in));
+  WireLogRecord in2 = {WireLog::kOpRead, 0, 0xA5, false, 0, 0, 0, 0};
+  assertTrue(wireLog.append(in2));
+
+  uint32_t pos = 0;
+  WireLogRecord out;
+  assertTrue(decodeOp(pos, WireLog::kOpTransfer, out));
+  assertEqual(0x68, out.addr);
+  assertEqual(3, out.data);
+  assertEqual(5, out.result);
+  assertEqual(300, out.quantity);
+  assertTrue(decodeOp(pos, WireLog::kOpRead, out));
+  assertEqual(0xA5, out.data);
+  assertEqual(wireLog.size(), pos);
+  assertFalse(wireLog.decode(pos, out));
+}
+
+//-----------------------------------------------------------------------------
+// Recording of transfer() and readInto().
+//-----------------------------------------------------------------------------
+
+test(WireLogTest, transferIsForwardedNatively) {
+  resetFake();
+  uint8_t reg = 0x10;
+  uint8_t data[3];
+  Message msgs[] = {
+    {kDevice, 0, 1, &reg},
+    {kDevice, Message::kRead, 3, data},
+  };
+  TransferResult result = recorder.transfer(msgs, 2);
+  assertEqual(0, result.status);
+  assertEqual(2, result.index);
+  assertEqual(1, nativeTransfers);
+  assertEqual(3, data[2]);
+
+  uint32_t pos = 0;
+  WireLogRecord record;
+  assertTrue(decodeOp(pos, WireLog::kOpTransfer, record));
+  assertEqual(kDevice, record.addr);
+  assertEqual(2, record.data);
+  assertEqual(2, record.quantity);
+  assertTrue(decodeOp(pos, WireLog::kOpWrite, record));
+  assertEqual(0x10, record.data);
+  for (uint8_t i = 1; i <= 3; ++i) {
+    assertTrue(decodeOp(pos, WireLog::kOpRead, record));
+    assertEqual(i, record.data);
+  }
+  assertFalse(wireLog.decode(pos, record));
+
+  WireLogSummary summary = wireLog.summarize();
+  assertEqual((uint32_t) 2, summary.starts);
+  assertEqual((uint32_t) 1, summary.bytesWritten);
+  assertEqual((uint32_t) 3, summary.bytesRead);
+  assertEqual((uint32_t) 0, summary.failures);
+}
+
+test(WireLogTest, readIntoIsForwardedNatively) {
+  resetFake();
+  uint8_t count = 0;
+  uint32_t n = recorder.readInto(kDevice, 0, [&](uint8_t) {
+    return ++count < 2;
+  });
+  assertEqual((uint32_t) 2, n);
+  assertEqual(1, nativeReads);
+  assertEqual(0, recorder.readInto(kMissing, 4, [](uint8_t) { return true; }));
+
+  uint32_t pos = 0;
+  WireLogRecord record;
+  assertTrue(decodeOp(pos, WireLog::kOpReadInto, record));
+  assertEqual(kDevice, record.addr);
+  assertEqual(1, record.result);
+  assertEqual(0, record.quantity);
+  assertTrue(decodeOp(pos, WireLog::kOpRead, record));
+  assertEqual(1, record.data);
+  assertTrue(decodeOp(pos, WireLog::kOpRead, record));
+  assertEqual(2, record.data);
+  assertTrue(decodeOp(pos, WireLog::kOpReadInto, record));
+  assertEqual(kMissing, record.addr);
+  assertEqual(0, record.result);
+  assertEqual(4, record.quantity);
+
+  WireLogSummary summary = wireLog.summarize();
+  assertEqual((uint32_t) 2, summary.starts);
+  assertEqual((uint32_t) 2, summary.bytesRead);
+  assertEqual((uint32_t) 1, summary.failures);
+}
+
+//-----------------------------------------------------------------------------
+// Record -> Replay round trip.
+//-----------------------------------------------------------------------------
+
+// A driver which uses every method of the interface, and returns a checksum
+// of all results and read bytes.
+template <typename T_WIREI>
+uint32_t runDriver(const T_WIREI& wireInterface) {
+  uint32_t sum = 0;
+  sum += wireInterface.beginTransmission(kDevice);
+  sum += wireInterface.write(0x20);
+  sum += wireInterface.endTransmission(false);
+  sum += wireInterface.requestFrom(kDevice, 2);
+  sum += wireInterface.read() * 3;
+  sum += wireInterface.read() * 5;
+
+  uint8_t reg = 0x30;
+  uint8_t data[4] = {0};
+  Message msgs[] = {
+    {kDevice, 0, 1, &reg},
+    {kDevice, Message::kRead, 4, data},
+  };
+  TransferResult result = wireInterface.transfer(msgs, 2);
+  sum += result.status * 7 + result.index * 11;
+  for (uint8_t i = 0; i < 4; ++i) sum += data[i] * (13 + i);
+
+  result = wireInterface.transfer(msgs + 1, 1);
+  sum += result.status * 7 + result.index * 11;
+
+  sum += wireInterface.readInto(kDevice, 3, [&](uint8_t b) {
+    sum += b * 17;
+    return true;
+  }) * 19;
+  sum += wireInterface.beginTransmission(kMissing) * 23;
+  return sum;
+}
+
+test(WireLogTest, replayReproducesRecording) {
+  resetFake();
+  uint32_t recorded = runDriver(recorder);
+
+  ReplayWireInterface replay(wireLog);
+  replay.begin();
+  nativeTransfers = 0;
+  nativeReads = 0;
+  assertEqual(recorded, runDriver(replay));
+  assertEqual(0, wireLog.mismatches());
+  assertEqual(0, wireLog.skipped());
+  assertEqual(wireLog.size(), wireLog.replayPosition());
+  assertEqual(0, nativeTransfers);
+  assertEqual(0, nativeReads);
+}
+
+test(WireLogTest, replayOfRecordedReplayHasSameSummary) {
+  resetFake();
+  runDriver(recorder);
+  WireLogSummary expected = wireLog.summarize();
+
+  uint8_t buffer2[256];
+  WireLog log2(buffer2, sizeof(buffer2));
+  ReplayWireInterface replay(wireLog);
+  RecordingWireInterface<ReplayWireInterface> recorder2(replay, log2);
+  replay.begin();
+  runDriver(recorder2);
+
+  WireLogSummary summary = log2.summarize();
+  assertEqual(expected.starts, summary.starts);
+  assertEqual(expected.bytesWritten, summary.bytesWritten);
+  assertEqual(expected.bytesRead, summary.bytesRead);
+  assertEqual(expected.failures, summary.failures);
+}
+
+test(WireLogTest, replayOfMissingTransferIsNack) {
+  resetFake();
+  ReplayWireInterface replay(wireLog);
+  replay.begin();
+
+  uint8_t data[2] = {0};
+  Message msgs[] = {{kDevice, Message::kRead, 2, data}};
+  TransferResult result = replay.transfer(msgs, 1);
+  assertEqual(2, result.status);
+  assertEqual(0, result.index);
+  assertEqual(0, replay.readInto(kDevice, 0, [](uint8_t) { return true; }));
+  assertEqual(2, wireLog.mismatches());
+}
+
+//-----------------------------------------------------------------------------
+
+void setup() {
+#if ! defined(EPOXY_DUINO)
+  delay(1000); // wait to prevent garbage on SERIAL_PORT_MONITOR
+#endif
+  SERIAL_PORT_MONITOR.begin(115200);
+  while (!SERIAL_PORT_MONITOR); // Leonardo/Micro
+}
+
+void loop() {
+  TestRunner::run();
+}